@@ -13,6 +13,7 @@
 
 #include <boost/asio.hpp>
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -25,6 +26,10 @@ namespace http{
 
 	/// \brief A reply to be sent to a client.
 	struct reply{
+		/// \brief Appends the next piece of the body to data, returns
+		///        false after the last piece.
+		using producer_fn = std::function< bool(std::string& data) >;
+
 		/// \brief The status of the reply.
 		enum status_type{
 			// Informational
@@ -65,6 +70,7 @@ namespace http{
 			unsupported_media_type = 415,
 			requested_range_not_satisfiable = 416,
 			expectation_failed = 417,
+			request_header_fields_too_large = 431,
 			// Server Error
 			internal_server_error = 500,
 			not_implemented = 501,
@@ -80,15 +86,35 @@ namespace http{
 		/// \brief The content to be sent in the reply.
 		std::string content;
 
+		/// \brief Produces the body piece by piece instead of content.
+		///
+		/// The connection asks for the next piece after the previous one
+		/// has been written, so at most one piece is held in memory. Every
+		/// call but the last must append at least one byte. Without a
+		/// Content-Length header the body is sent chunked to HTTP/1.1
+		/// clients and delimited by closing the connection for HTTP/1.0
+		/// clients.
+		producer_fn producer;
+
 		/// \brief Convert the reply into a vector of buffers.
 		///
 		/// The buffers do not own the underlying memory blocks,
 		/// therefore the reply object must remain valid and
 		/// not be changed until the write operation has completed.
+		///
+		/// The content is omitted if the reply has a producer.
 		std::vector< asio::const_buffer > to_buffers() const;
 
+		/// \brief Append the buffers of the reply to a vector of buffers.
+		///
+		/// Allows to send several replies with a single write operation.
+		void to_buffers(std::vector< asio::const_buffer >& buffers) const;
+
 		/// \brief Get a stock reply.
 		static reply stock_reply(status_type status);
+
+		/// \brief false if replies with this status never have a body.
+		static bool has_body(status_type status);
 	};
 
 
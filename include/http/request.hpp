@@ -25,6 +25,7 @@ namespace http{
 		int http_version_major;
 		int http_version_minor;
 		header headers;
+		std::string body;
 	};
 
 
@@ -0,0 +1,156 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#ifndef _http__server_blocking_request_handler__hpp_INCLUDED_
+#define _http__server_blocking_request_handler__hpp_INCLUDED_
+
+#include "server_request_handler.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace http::server{
+
+
+	/// \brief Runs the requests of another handler in a worker pool.
+	///
+	/// Use it for handlers that block, e.g. callback_file_request_handler
+	/// with slow callbacks, so they don't stall the other connections of
+	/// an I/O thread. The reply is completed within the strand of the
+	/// connection. If the queue is full, the request is answered with 503
+	/// at once.
+	class blocking_request_handler: public request_handler{
+	public:
+		/// \brief Selects the requests, that are run in the worker pool.
+		using predicate_fn = std::function< bool(http::request const&) >;
+
+
+		/// \brief Run the requests of handler in thread_count worker
+		///        threads, with at most queue_size waiting requests.
+		///
+		/// If blocking is set, only the requests it selects are run by the
+		/// workers, the others directly by the I/O thread.
+		blocking_request_handler(
+			request_handler& handler,
+			std::size_t thread_count,
+			std::size_t queue_size,
+			predicate_fn blocking = predicate_fn(),
+			std::chrono::seconds retry_after = std::chrono::seconds(1)
+		);
+
+		/// \brief Finish the queued requests and join the workers.
+		~blocking_request_handler();
+
+		/// \brief Handle a request by the wrapped handler in the calling
+		///        thread.
+		virtual bool handle_request(
+			connection_ptr const& connection,
+			http::request const& req,
+			http::reply& rep
+		)override;
+
+		/// \brief Queue the request for the worker pool.
+		virtual void async_handle_request(
+			connection_ptr const& connection,
+			http::request const& req,
+			http::reply& rep,
+			complete_fn complete
+		)override;
+
+		/// \brief Ask the wrapped handler.
+		virtual bool check_continue(
+			connection_ptr const& connection,
+			http::request const& req,
+			http::reply& rep
+		)override;
+
+		/// \brief Ask the wrapped handler.
+		virtual body_fn stream_body(
+			connection_ptr const& connection,
+			http::request const& req
+		)override;
+
+		/// \brief Answer further requests with 503 and forward to the
+		///        wrapped handler.
+		virtual void shutdown()override;
+
+		/// \brief Count of requests waiting for a worker.
+		std::size_t queued()const;
+
+		/// \brief Count of requests answered with 503 because the queue
+		///        was full.
+		std::size_t rejected()const;
+
+
+	private:
+		/// \brief A queued request.
+		struct task{
+			/// \brief The connection of the request.
+			connection_ptr connection;
+
+			/// \brief The request.
+			http::request const& req;
+
+			/// \brief The reply to produce.
+			http::reply& rep;
+
+			/// \brief Completes the reply.
+			complete_fn complete;
+		};
+
+		/// \brief Process queued requests until the handler is destroyed.
+		void work();
+
+		/// \brief Answer a request with 503.
+		void reject(http::reply& rep)const;
+
+		/// \brief The wrapped handler.
+		request_handler& handler_;
+
+		/// \brief Maximal count of queued requests.
+		std::size_t const queue_size_;
+
+		/// \brief Selects the requests, that are run in the worker pool.
+		predicate_fn const blocking_;
+
+		/// \brief Value of the Retry-After header of 503 replies.
+		std::chrono::seconds const retry_after_;
+
+		/// \brief Protect all following data members.
+		mutable std::mutex mutex_;
+
+		/// \brief Signaled when a task is queued or the workers stop.
+		std::condition_variable ready_;
+
+		/// \brief Requests waiting for a worker.
+		std::deque< task > queue_;
+
+		/// \brief true after shutdown().
+		bool shutdown_ = false;
+
+		/// \brief true when the destructor stops the workers.
+		bool stop_ = false;
+
+		/// \brief Count of requests answered with 503.
+		std::size_t rejected_ = 0;
+
+		/// \brief The worker threads.
+		std::vector< std::thread > workers_;
+	};
+
+
+}
+
+
+#endif
@@ -0,0 +1,122 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#ifndef _http__server_body_parser__hpp_INCLUDED_
+#define _http__server_body_parser__hpp_INCLUDED_
+
+#include "header.hpp"
+#include "reply.hpp"
+#include "request.hpp"
+#include "server_options.hpp"
+
+#include <boost/logic/tribool.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+
+namespace http::server{
+
+
+	/// \brief Parser for the body of incoming requests.
+	///
+	/// Reads a body of Content-Length bytes or decodes a chunked body
+	/// (Transfer-Encoding: chunked) incrementally.
+	class body_parser{
+	public:
+		/// \brief Construct with the limits of the options.
+		explicit body_parser(options const& options);
+
+		/// \brief Prepare for the body announced by the header of a request.
+		///
+		/// \return reply::ok or the status of the error reply if the header
+		///         is invalid
+		reply::status_type start(http::request const& req);
+
+		/// \brief Reset to a request without body.
+		void reset();
+
+		/// \brief true while the body is not completely parsed.
+		bool active()const{ return state_ != done; }
+
+		/// \brief true if the body is chunked.
+		bool chunked()const{ return chunked_; }
+
+		/// \brief Length of the body announced by Content-Length.
+		std::uint64_t content_length()const{ return content_length_; }
+
+		/// \brief Header fields of the trailer of a chunked body.
+		http::header& trailers(){ return trailers_; }
+
+		/// \brief Parse some data.
+		///
+		/// The tribool return value is true when the body is complete, false
+		/// if the data is invalid, indeterminate when more data is required.
+		/// The string_view is the payload within the consumed data, the
+		/// pointer indicates how much of the input has been consumed.
+		std::tuple< boost::tribool, std::string_view, char const* > parse(
+			char const* begin, char const* end
+		);
+
+	private:
+		/// \brief Handle the next character of the chunk framing.
+		boost::tribool consume(char input);
+
+		/// \brief Add the trailer field in line_ to trailers_.
+		bool add_trailer();
+
+		/// \brief Configuration of the server.
+		options const& options_;
+
+		/// \brief true if the body is chunked.
+		bool chunked_ = false;
+
+		/// \brief Length of the body announced by Content-Length.
+		std::uint64_t content_length_ = 0;
+
+		/// \brief Count of payload bytes of the body or the current chunk
+		///        not yet parsed.
+		std::uint64_t remaining_ = 0;
+
+		/// \brief Length of the current chunk extension.
+		std::size_t extension_size_ = 0;
+
+		/// \brief Length of the trailer so far.
+		std::size_t trailer_size_ = 0;
+
+		/// \brief The current trailer field line.
+		std::string line_;
+
+		/// \brief Header fields of the trailer of a chunked body.
+		http::header trailers_;
+
+		/// \brief The current state of the parser.
+		enum state{
+			content,
+			chunk_size_start,
+			chunk_size,
+			chunk_extension,
+			chunk_size_newline,
+			chunk_data,
+			chunk_data_cr,
+			chunk_data_newline,
+			trailer_line_start,
+			trailer_line,
+			trailer_newline,
+			final_newline,
+			done
+		} state_ = done;
+	};
+
+
+}
+
+
+#endif
@@ -9,6 +9,7 @@
 #ifndef _http__server_virtual_file_request_handler__hpp_INCLUDED_
 #define _http__server_virtual_file_request_handler__hpp_INCLUDED_
 
+#include "reply.hpp"
 #include "server_basic_file_request_handler.hpp"
 
 #include <map>
@@ -41,6 +42,16 @@ namespace http::server{
 				callback
 		);
 
+		/// \brief Add a new virtual file, whose content is streamed
+		///
+		/// The callback returns the producer of the content of a request.
+		bool add_streamed(
+			std::string const& filename,
+			std::string const& mime_type,
+			std::function< http::reply::producer_fn(
+				http::request const& req) > const& callback
+		);
+
 		/// \brief erase a file
 		bool erase(std::string const& filename);
 
@@ -51,10 +62,12 @@ namespace http::server{
 		/// \brief Sub directory for virtual files
 		std::string const dir_;
 
-		/// \brief map< filename, tuple< mime_type, content > >
+		/// \brief map< filename, tuple< mime_type, content, producer > >
 		std::map< std::string, std::tuple<
 				std::string,
-				std::function< std::string(http::request const& req) >
+				std::function< std::string(http::request const& req) >,
+				std::function< http::reply::producer_fn(
+					http::request const& req) >
 			> > files_;
 	};
 
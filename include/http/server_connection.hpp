@@ -11,14 +11,23 @@
 
 #include "reply.hpp"
 #include "request.hpp"
+#include "server_body_parser.hpp"
+#include "server_connection_manager.hpp"
+#include "server_handler_allocator.hpp"
+#include "server_options.hpp"
 #include "server_request_handler.hpp"
 #include "server_request_parser.hpp"
+#include "server_timer_wheel.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/noncopyable.hpp>
 
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <string_view>
 
 
 namespace http::server{
@@ -27,8 +36,12 @@ namespace http::server{
 	using boost::system::error_code;
 	using asio::ip::tcp;
 
+	/// \brief Protocol of TCP as well as of Unix domain socket connections.
+	using stream_protocol = asio::generic::stream_protocol;
+
 
 	class connection;
+	class http2_session;
 
 	using connection_ptr = std::shared_ptr< connection >;
 	using weak_connection_ptr = std::weak_ptr< connection >;
@@ -40,6 +53,11 @@ namespace http::server{
 	using callback_read_fn = std::function<
 		void(connection_ptr const&, std::string const&, error_code const&) >;
 
+	/// \brief Gets a view of the received data, returns the count of
+	///        consumed bytes
+	using callback_read_view_fn = std::function< std::size_t(
+		connection_ptr const&, std::string_view, error_code const&) >;
+
 
 	/// \brief Represents a single connection from a client.
 	///
@@ -52,59 +70,443 @@ namespace http::server{
 		~connection();
 
 		/// \brief Get the socket associated with the connection.
-		tcp::socket& socket();
+		stream_protocol::socket& socket();
 
 		/// \brief Start the first asynchronous operation for the connection.
+		///
+		/// Requests are read and answered until the client or the server
+		/// closes the connection or a handler takes it over. The connection
+		/// must have been admitted by connection_manager::add_connection().
 		void start(request_handler& handler);
 
 		/// \brief The callback is called, when the start function has finished
 		void ready_callback(callback_write_fn callback);
 
 		/// \brief Start another asynchronous read operation
+		///
+		/// The callback gets a copy of the received data.
 		void read(callback_read_fn callback);
 
-		/// \brief Start a synchronous write operation
-		error_code write(std::shared_ptr< std::string const > const& data);
+		/// \brief Start another asynchronous read operation without copying
+		///        the received data
+		///
+		/// The view refers to the read buffer of the connection and is only
+		/// valid during the callback. Bytes not consumed by the callback are
+		/// passed again in front of the data of the next read, which fails
+		/// with asio::error::no_buffer_space if they fill a buffer of
+		/// options::max_read_buffer_size.
+		void read_view(callback_read_view_fn callback);
+
+		/// \brief Queue data for an asynchronous write operation
+		///
+		/// Can be called from any thread after a handler has taken over the
+		/// connection. The data is written in the order of the calls, the
+		/// callback is called within the strand after the data is written or
+		/// an error occurred.
+		///
+		/// If options::write_queue_limit would be exceeded, the data is not
+		/// queued and the callback gets asio::error::no_buffer_space.
+		///
+		/// \return false if the caller should stop writing, because more
+		///         than options::write_high_water_mark bytes are queued or
+		///         the data was rejected
+		bool write(
+			std::shared_ptr< std::string const > data,
+			callback_write_fn callback = callback_write_fn()
+		);
+
+		/// \brief Count of bytes queued by write() and not yet written
+		std::size_t queued_bytes()const{ return queued_bytes_; }
+
+		/// \brief The io_service that runs the handlers of the connection
+		asio::io_service& io_service(){ return io_service_; }
+
+		/// \brief Request the handler to be called within the strand of
+		///        the connection
+		///
+		/// Can be called from any thread.
+		template < typename Handler >
+		void post(Handler&& handler){
+			if(strand_){
+				strand_->post(std::forward< Handler >(handler));
+			}else{
+				io_service_.post(std::forward< Handler >(handler));
+			}
+		}
+
+		/// \brief Close the connection within its strand
+		///
+		/// If force is false, the connection is only closed while it waits
+		/// for the next request. An HTTP/2 connection announces the
+		/// shutdown by GOAWAY and is closed after its open streams.
+		void shutdown(bool force);
+
+		/// \brief Close the connection, if the handler that has taken it
+		///        over doesn't change the timeout within timeout, 0
+		///        disables it
+		///
+		/// Must be called within the strand. While data of write() is
+		/// written, options::write_timeout applies instead.
+		void timeout(std::chrono::milliseconds timeout);
 
 	protected:
 		/// \brief Construct a connection with the given io_service.
-		explicit connection(asio::io_service& io_service);
+		connection(
+			asio::io_service& io_service,
+			options const& options,
+			timer_wheel& timer_wheel,
+			http::server::connection_manager& connection_manager
+		);
 
 
 	private:
-		/// \brief Handle completion of the first read operation.
-		void handle_first_read(
-			request_handler& handler,
-			std::shared_ptr< http::request > const& request,
-			std::shared_ptr< request_parser > const& request_parser,
-			std::shared_ptr< http::reply > const& reply,
-			error_code const& err,
-			std::size_t bytes_transferred
-		);
-
-		/// \brief Handle completion of the first write operation.
-		void handle_first_write(error_code const& err);
+		/// \brief Wait asynchronously until the next request data arrives.
+		void do_read();
+
+		/// \brief Read the received data, when the socket is readable.
+		void handle_read(error_code err);
+
+		/// \brief Append the received data of a readable socket to the read
+		///        buffer.
+		///
+		/// \return Count of received bytes
+		std::size_t receive(error_code& err);
+
+		/// \brief Pass the unprocessed data of the read buffer to a
+		///        read_view() callback.
+		void deliver(callback_read_view_fn const& callback, error_code err);
+
+		/// \brief Get a read buffer from the pool of the calling thread, if
+		///        the connection holds none.
+		void acquire_buffer();
+
+		/// \brief Return the read buffer to the pool of the calling thread.
+		void release_buffer();
+
+		/// \brief Parse and handle all complete requests in the buffer.
+		///
+		/// If keep_alive is false, only the replies are sent.
+		void handle_buffer(bool keep_alive = true);
+
+		/// \brief Prepare for the body of the request, whose header is
+		///        parsed, or handle the request if it has none.
+		///
+		/// \return false if the connection is closed after the reply
+		bool start_body();
+
+		/// \brief Parse the body data in the buffer and handle the request
+		///        when it is complete.
+		///
+		/// \return false if the connection is closed after the reply
+		bool handle_body();
+
+		/// \brief Call the request handler for the completely received
+		///        request.
+		///
+		/// \return false if the connection is closed after the reply
+		bool finish_request();
+
+		/// \brief Called by the completion function of
+		///        request_handler::async_handle_request().
+		///
+		/// work keeps the io_service running until the reply is continued.
+		void complete_request(asio::io_service::work const& work);
+
+		/// \brief Prepare the completed reply and the connection for the
+		///        next request.
+		///
+		/// \return false if the connection is closed after the reply
+		bool finish_reply();
+
+		/// \brief Answer the request with a stock reply and close the
+		///        connection after it.
+		///
+		/// \return false
+		bool fail_request(reply::status_type status);
+
+		/// \brief Answer the request with rep and close the connection
+		///        after it.
+		///
+		/// \return false
+		bool fail_request(http::reply rep);
+
+		/// \brief Hand the connection over to HTTP/2 after the client
+		///        preface "PRI * HTTP/2.0".
+		void start_http2();
+
+		/// \brief Answer "Upgrade: h2c" with "101 Switching Protocols" and
+		///        the request by HTTP/2 after it.
+		///
+		/// \return false
+		bool upgrade_http2();
+
+		/// \brief Handle the Expect header of a request with body.
+		///
+		/// \return false if the request is rejected
+		bool check_expectation();
+
+		/// \brief Send all replies with a single write operation.
+		void write_replies(bool keep_alive);
+
+		/// \brief Handle completion of a reply write operation.
+		///
+		/// Writes the next piece of a streamed reply, if there is one.
+		void handle_write(error_code const& err, bool keep_alive);
+
+		/// \brief Get the next piece of the streamed reply and append its
+		///        buffers to write_buffers_.
+		void produce_body();
+
+		/// \brief Shut down the sending side after the last reply and
+		///        discard the data of the client until it closes the
+		///        connection or options::linger_timeout expires.
+		void linger();
+
+		/// \brief Discard the received data, when the socket is readable.
+		void handle_linger(error_code err);
+
+		/// \brief Write the first entries of write_queue_ with a single
+		///        write operation.
+		void do_write();
+
+		/// \brief Handle completion of a queued write operation.
+		void handle_queued_write(error_code const& err);
+
+		/// \brief Decide whether the connection persists after the reply and
+		///        set the reply headers accordingly.
+		bool keep_alive(http::request const& req, http::reply& rep) const;
+
+		/// \brief Reset the request state for the next request.
+		void reset_request();
+
+		/// \brief Close the connection if no operation completes within the
+		///        timeout, 0 disables the timeout.
+		void set_timeout(std::chrono::milliseconds timeout);
+
+		/// \brief Close the connection, if its timeout has expired.
+		void handle_timeout();
+
+		/// \brief Continue the timeout set by timeout() after a queued
+		///        write operation.
+		void resume_timeout();
+
+		/// \brief Close the socket, pending operations are cancelled.
+		void close();
+
+		/// \brief Close the socket and reset the state for reuse by another
+		///        client.
+		void reset();
+
+		/// \brief Start an asynchronous operation, its completion handler is
+		///        wrapped by the strand if the connection has one.
+		///
+		/// The operation is allocated from the given memory.
+		template < typename Operation, typename Handler >
+		void async(
+			handler_memory& memory,
+			Operation&& operation,
+			Handler&& handler
+		){
+			auto alloc_handler = make_custom_alloc_handler(
+				memory, std::forward< Handler >(handler));
+			if(strand_){
+				operation(strand_->wrap(std::move(alloc_handler)));
+			}else{
+				operation(std::move(alloc_handler));
+			}
+		}
+
+		/// \brief The io_service of the socket.
+		asio::io_service& io_service_;
 
 		/// \brief Strand to ensure the connection's handlers are not called
 		///        concurrently.
-		asio::io_service::strand strand_;
+		///
+		/// Not needed if only one thread runs the io_service.
+		std::optional< asio::io_service::strand > strand_;
 
 		/// \brief Socket for the connection.
-		tcp::socket socket_;
+		stream_protocol::socket socket_;
+
+		/// \brief Buffer for incoming data, only present while the received
+		///        data is processed.
+		std::unique_ptr< char[] > buffer_;
+
+		/// \brief Size of buffer_.
+		std::size_t buffer_size_ = 0;
+
+		/// \brief Size of the next acquired buffer_.
+		std::size_t read_size_;
+
+		/// \brief true if a read_view() callback has not consumed all data.
+		bool unconsumed_ = false;
+
+		/// \brief true while a read_view() callback is called.
+		bool delivering_ = false;
+
+		/// \brief read_view() callback of a call within a callback, it is
+		///        started after the callback has returned.
+		callback_read_view_fn next_read_;
+
+		/// \brief Begin of the not yet parsed data in buffer_.
+		std::size_t buffer_begin_ = 0;
+
+		/// \brief End of the received data in buffer_.
+		std::size_t buffer_end_ = 0;
+
+		/// \brief Configuration of the server.
+		options const& options_;
+
+		/// \brief The handler for all incoming requests.
+		request_handler* request_handler_ = nullptr;
+
+		/// \brief The incoming request.
+		http::request request_;
+
+		/// \brief The parser for the incoming request.
+		http::server::request_parser request_parser_;
+
+		/// \brief The parser for the body of the incoming request.
+		http::server::body_parser body_parser_;
+
+		/// \brief Receives the body of the incoming request, if the
+		///        request handler streams it.
+		body_fn body_callback_;
+
+		/// \brief State of the reply of request_handler_.
+		enum class completion{
+			/// \brief async_handle_request() is running
+			running,
+
+			/// \brief The reply is complete
+			completed,
+
+			/// \brief async_handle_request() has returned, the reply is
+			///        completed later
+			deferred
+		};
+
+		/// \brief State of the reply of the current request.
+		std::atomic< completion > completion_{completion::completed};
+
+		/// \brief true while the handler has not completed the reply of
+		///        the current request.
+		bool handling_ = false;
+
+		/// \brief The replies to be sent back to the client, one per
+		///        pipelined request.
+		std::vector< http::reply > replies_;
 
-		/// \brief Buffer for incoming data.
-		std::array< char, 8192 > buffer_;
+		/// \brief The buffers of the current write operation, of all
+		///        replies_ or of the first entries of write_queue_.
+		std::vector< asio::const_buffer > write_buffers_;
 
-		/// \brief Is called after handle_first_write
+		/// \brief true if "100 Continue" is sent with the next write.
+		bool send_continue_ = false;
+
+		/// \brief true while the last of replies_ produces further body
+		///        pieces.
+		bool streaming_ = false;
+
+		/// \brief true if the streamed reply is sent chunked.
+		bool chunked_reply_ = false;
+
+		/// \brief The current piece of the streamed reply.
+		std::string body_piece_;
+
+		/// \brief Chunk size line of body_piece_.
+		std::string chunk_header_;
+
+		/// \brief Memory for the handlers of read operations.
+		handler_memory read_memory_;
+
+		/// \brief Memory for the handlers of write operations.
+		handler_memory write_memory_;
+
+		/// \brief Count of requests received over this connection.
+		std::size_t request_count_ = 0;
+
+		/// \brief The timer wheel of the io_service.
+		timer_wheel& timer_wheel_;
+
+		/// \brief The timeout of the current operation.
+		timer_wheel::entry timeout_;
+
+		/// \brief Time when timeout_ expires.
+		timer_wheel::clock::time_point deadline_;
+
+		/// \brief Deadline set by timeout(), it applies while no queued
+		///        write operation is in progress.
+		timer_wheel::clock::time_point takeover_deadline_ =
+			timer_wheel::clock::time_point::max();
+
+		/// \brief true while the connection waits for the next request.
+		bool idle_ = false;
+
+		/// \brief Is called after the first reply write, that has taken over
+		///        the connection
 		callback_write_fn ready_callback_;
 
+		/// \brief The HTTP/2 session, that has taken over the connection.
+		std::weak_ptr< http2_session > http2_session_;
 
-		friend connection_ptr
-			make_shared_connection(asio::io_service& io_service);
+		/// \brief Data of a write() call.
+		struct queued_write{
+			/// \brief The data to write.
+			std::shared_ptr< std::string const > data;
+
+			/// \brief Is called after the data is written.
+			callback_write_fn callback;
+		};
+
+		/// \brief Data of write() calls, the first entries are being
+		///        written.
+		std::deque< queued_write > write_queue_;
+
+		/// \brief Count of entries of write_queue_ in the current write
+		///        operation.
+		std::size_t writing_ = 0;
+
+		/// \brief true while TCP_CORK is set.
+		bool corked_ = false;
+
+		/// \brief true while TCP_QUICKACK is set again after every read,
+		///        Linux falls back to delayed acknowledgments otherwise.
+		bool quick_ack_ = false;
+
+		/// \brief Count of bytes in write_queue_ and in the posted write()
+		///        calls.
+		std::atomic< std::size_t > queued_bytes_{0};
+
+		/// \brief Counts the connections and requests of the server.
+		http::server::connection_manager& connection_manager_;
+
+		/// \brief Count of requests in replies_ admitted by
+		///        connection_manager_.
+		std::size_t admitted_requests_ = 0;
+
+		/// \brief true if the overload reply is sent behind replies_.
+		bool overloaded_ = false;
+
+
+		friend class connection_pool;
+
+		friend connection_ptr make_shared_connection(
+			asio::io_service& io_service,
+			options const& options,
+			timer_wheel& timer_wheel,
+			http::server::connection_manager& connection_manager
+		);
 	};
 
-	inline connection_ptr make_shared_connection(asio::io_service& io_service){
-		return connection_ptr(new connection(io_service));
+	inline connection_ptr make_shared_connection(
+		asio::io_service& io_service,
+		options const& options,
+		timer_wheel& timer_wheel,
+		http::server::connection_manager& connection_manager
+	){
+		return connection_ptr(new connection(
+			io_service, options, timer_wheel, connection_manager));
 	}
 
 
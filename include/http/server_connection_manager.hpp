@@ -0,0 +1,127 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#ifndef _http__server_connection_manager__hpp_INCLUDED_
+#define _http__server_connection_manager__hpp_INCLUDED_
+
+#include "server_options.hpp"
+
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+
+namespace http::server{
+
+
+	class connection;
+
+
+	/// \brief Counts the connections and requests of a server and decides
+	///        about their admission.
+	class connection_manager: private boost::noncopyable{
+	public:
+		/// \brief Construct with the limits of the options.
+		explicit connection_manager(options const& options);
+
+		/// \brief Count a new connection, false if the limit is reached.
+		bool add_connection();
+
+		/// \brief Register a started connection.
+		void register_connection(connection& connection);
+
+		/// \brief Count a closed connection and unregister it.
+		void remove_connection(connection& connection);
+
+		/// \brief Count a new request, false if the limit is reached.
+		bool add_request();
+
+		/// \brief Count finished requests.
+		void remove_requests(std::size_t count);
+
+		/// \brief true if no further connection is accepted.
+		bool connections_exhausted()const;
+
+		/// \brief Count of open connections.
+		std::size_t connections()const{ return connections_; }
+
+		/// \brief Count of requests in process.
+		std::size_t requests()const{ return requests_; }
+
+		/// \brief The complete 503 reply sent on overload.
+		std::string const& overload_reply()const{ return overload_reply_; }
+
+		/// \brief Set the function, that is called when a connection closes
+		///        after connections_exhausted() was true.
+		void resume_callback(std::function< void() > callback);
+
+		/// \brief Mark that accepting is paused until resume_callback is
+		///        called.
+		void pause();
+
+		/// \brief Persistent connections are closed after their next reply.
+		void start_drain();
+
+		/// \brief true after start_drain().
+		bool draining()const{ return draining_; }
+
+		/// \brief Get all registered connections, that are still alive.
+		std::vector< std::shared_ptr< connection > > registered_connections();
+
+		/// \brief Wait until all connections are closed or the deadline is
+		///        reached.
+		///
+		/// \return true if all connections are closed
+		bool wait_closed(std::chrono::steady_clock::time_point deadline);
+
+
+	private:
+		/// \brief Configuration of the server.
+		options const& options_;
+
+		/// \brief Count of open connections.
+		std::atomic< std::size_t > connections_{0};
+
+		/// \brief Count of requests in process.
+		std::atomic< std::size_t > requests_{0};
+
+		/// \brief true while accepting is paused.
+		std::atomic< bool > paused_{false};
+
+		/// \brief true after start_drain().
+		std::atomic< bool > draining_{false};
+
+		/// \brief Protect connections_list_.
+		std::mutex mutex_;
+
+		/// \brief Signaled when a connection is closed while draining.
+		std::condition_variable closed_;
+
+		/// \brief All started connections.
+		std::unordered_set< connection* > connection_list_;
+
+		/// \brief Is called when accepting can be resumed.
+		std::function< void() > resume_callback_;
+
+		/// \brief The complete 503 reply sent on overload.
+		std::string const overload_reply_;
+	};
+
+
+}
+
+
+#endif
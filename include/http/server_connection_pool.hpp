@@ -0,0 +1,124 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#ifndef _http__server_connection_pool__hpp_INCLUDED_
+#define _http__server_connection_pool__hpp_INCLUDED_
+
+#include "server_connection.hpp"
+#include "server_connection_manager.hpp"
+#include "server_options.hpp"
+#include "server_timer_wheel.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace http::server{
+
+
+	/// \brief Recycles the connection objects of one io_service.
+	///
+	/// A connection handed out by the pool returns to it, when its last
+	/// connection_ptr is gone. It is reset and reused by the next get() call,
+	/// as long as the pool does not hold options::connection_pool_size idle
+	/// connections already.
+	class connection_pool:
+		private boost::noncopyable,
+		public std::enable_shared_from_this< connection_pool >{
+	public:
+		/// \brief Counters of the pool
+		struct statistics{
+			/// \brief Count of newly allocated connections
+			std::size_t created = 0;
+
+			/// \brief Count of connections handed out from the pool
+			std::size_t reused = 0;
+
+			/// \brief Count of connections that went back into the pool
+			std::size_t recycled = 0;
+
+			/// \brief Count of connections deleted because the pool was full
+			std::size_t discarded = 0;
+
+			/// \brief Count of connections currently in the pool
+			std::size_t idle = 0;
+		};
+
+
+		/// \brief Construct a pool for connections of the io_service.
+		///
+		/// Use std::make_shared, get() requires shared ownership.
+		connection_pool(
+			asio::io_service& io_service,
+			options const& options,
+			http::server::timer_wheel& timer_wheel,
+			http::server::connection_manager& connection_manager
+		);
+
+		/// \brief Get a connection from the pool or create a new one.
+		connection_ptr get();
+
+		/// \brief Get the counters of the pool.
+		statistics get_statistics()const;
+
+
+	private:
+		/// \brief Returns a connection to its pool or deletes it.
+		struct deleter{
+			/// \brief The pool the connection belongs to
+			std::weak_ptr< connection_pool > pool;
+
+			/// \brief Recycle the connection.
+			void operator()(connection* connection)const;
+		};
+
+		/// \brief Reset the connection and keep it for reuse, if there is
+		///        enough space.
+		void recycle(connection* connection);
+
+		/// \brief The io_service of all connections.
+		asio::io_service& io_service_;
+
+		/// \brief Configuration of the server.
+		options const& options_;
+
+		/// \brief The timer wheel of the io_service.
+		http::server::timer_wheel& timer_wheel_;
+
+		/// \brief Counts the connections and requests of the server.
+		http::server::connection_manager& connection_manager_;
+
+		/// \brief Protect idle_
+		mutable std::mutex mutex_;
+
+		/// \brief Connections ready for reuse.
+		std::vector< std::unique_ptr< connection > > idle_;
+
+		/// \brief Count of newly allocated connections.
+		std::atomic< std::size_t > created_{0};
+
+		/// \brief Count of connections handed out from the pool.
+		std::atomic< std::size_t > reused_{0};
+
+		/// \brief Count of connections that went back into the pool.
+		std::atomic< std::size_t > recycled_{0};
+
+		/// \brief Count of connections deleted because the pool was full.
+		std::atomic< std::size_t > discarded_{0};
+	};
+
+
+}
+
+
+#endif
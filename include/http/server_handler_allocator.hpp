@@ -0,0 +1,170 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#ifndef _http__server_handler_allocator__hpp_INCLUDED_
+#define _http__server_handler_allocator__hpp_INCLUDED_
+
+#include <boost/noncopyable.hpp>
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace http::server{
+
+
+	/// \brief Memory for the handler of one asynchronous operation at a time.
+	///
+	/// Asio allocates every operation together with its completion handler.
+	/// A connection owns one handler_memory per kind of operation, so steady
+	/// state reads and writes reuse the same memory instead of the heap.
+	class handler_memory: private boost::noncopyable{
+	public:
+		/// \brief Get memory from the storage, if it is large enough and
+		///        free, otherwise from the heap.
+		void* allocate(std::size_t size){
+			if(!in_use_ && size <= sizeof(storage_)){
+				in_use_ = true;
+				return &storage_;
+			}
+
+			return ::operator new(size);
+		}
+
+		/// \brief Give the memory back.
+		void deallocate(void* pointer){
+			if(pointer == &storage_){
+				in_use_ = false;
+			}else{
+				::operator delete(pointer);
+			}
+		}
+
+	private:
+		/// \brief Storage for one operation.
+		std::aligned_storage_t< 1024 > storage_;
+
+		/// \brief true while the storage is in use.
+		bool in_use_ = false;
+	};
+
+
+	/// \brief Standard allocator interface for handler_memory.
+	template < typename T >
+	class handler_allocator{
+	public:
+		using value_type = T;
+
+		/// \brief Construct with the memory to use.
+		explicit handler_allocator(handler_memory& memory):
+			memory_(memory)
+			{}
+
+		/// \brief Rebind from another value type.
+		template < typename U >
+		handler_allocator(handler_allocator< U > const& other) noexcept:
+			memory_(other.memory_)
+			{}
+
+		/// \brief Allocate memory for n objects.
+		T* allocate(std::size_t n)const{
+			return static_cast< T* >(memory_.allocate(sizeof(T) * n));
+		}
+
+		/// \brief Deallocate memory.
+		void deallocate(T* pointer, std::size_t)const{
+			memory_.deallocate(pointer);
+		}
+
+		template < typename U >
+		bool operator==(handler_allocator< U > const& other)const noexcept{
+			return &memory_ == &other.memory_;
+		}
+
+		template < typename U >
+		bool operator!=(handler_allocator< U > const& other)const noexcept{
+			return &memory_ != &other.memory_;
+		}
+
+	private:
+		template < typename > friend class handler_allocator;
+
+		/// \brief The memory to use.
+		handler_memory& memory_;
+	};
+
+
+	/// \brief Wraps a completion handler to allocate its operation from a
+	///        handler_memory.
+	///
+	/// Supports the associated allocator as well as the allocation hooks,
+	/// which are forwarded to the inner handler by strand wrapping.
+	template < typename Handler >
+	class custom_alloc_handler{
+	public:
+		using allocator_type = handler_allocator< Handler >;
+
+		/// \brief Construct with memory and handler.
+		custom_alloc_handler(handler_memory& memory, Handler handler):
+			memory_(memory),
+			handler_(std::move(handler))
+			{}
+
+		/// \brief Get the allocator for the operation.
+		allocator_type get_allocator()const noexcept{
+			return allocator_type(memory_);
+		}
+
+		/// \brief Call the handler.
+		template < typename ... Args >
+		void operator()(Args&& ... args){
+			handler_(std::forward< Args >(args) ...);
+		}
+
+		/// \brief Allocation hook.
+		friend void* asio_handler_allocate(
+			std::size_t size,
+			custom_alloc_handler< Handler >* this_handler
+		){
+			return this_handler->memory_.allocate(size);
+		}
+
+		/// \brief Deallocation hook.
+		friend void asio_handler_deallocate(
+			void* pointer,
+			std::size_t,
+			custom_alloc_handler< Handler >* this_handler
+		){
+			this_handler->memory_.deallocate(pointer);
+		}
+
+	private:
+		/// \brief The memory to use.
+		handler_memory& memory_;
+
+		/// \brief The wrapped handler.
+		Handler handler_;
+	};
+
+
+	/// \brief Wrap a handler to allocate its operation from the memory.
+	template < typename Handler >
+	inline custom_alloc_handler< Handler > make_custom_alloc_handler(
+		handler_memory& memory,
+		Handler handler
+	){
+		return custom_alloc_handler< Handler >(memory, std::move(handler));
+	}
+
+
+}
+
+
+#endif
@@ -0,0 +1,101 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#ifndef _http__server_hpack__hpp_INCLUDED_
+#define _http__server_hpack__hpp_INCLUDED_
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace http::server{
+
+
+	/// \brief A header field of an HTTP/2 header block.
+	using hpack_field = std::pair< std::string, std::string >;
+
+	/// \brief The decoded header fields of an HTTP/2 header block.
+	using hpack_field_list = std::vector< hpack_field >;
+
+
+	/// \brief Decoder for HTTP/2 header blocks (HPACK, RFC 7541).
+	///
+	/// The dynamic table is shared by all header blocks of a connection,
+	/// so every block must be decoded in the order it was received.
+	class hpack_decoder{
+	public:
+		/// \brief Result of decode().
+		enum result{
+			/// \brief The block is decoded
+			ok,
+
+			/// \brief The block is decoded, but its fields exceed the
+			///        maximal header list size and are dropped
+			too_large,
+
+			/// \brief The block is invalid, the connection is unusable
+			invalid
+		};
+
+
+		/// \brief Construct with the dynamic table size announced to the
+		///        peer and the maximal size of a decoded field list.
+		hpack_decoder(std::size_t max_table_size, std::size_t max_list_size);
+
+		/// \brief Decode a complete header block into fields.
+		result decode(std::string_view block, hpack_field_list& fields);
+
+	private:
+		/// \brief Get the field of a static or dynamic table index, false
+		///        if the index is invalid.
+		bool field(std::size_t index, hpack_field& entry)const;
+
+		/// \brief Add a field to the dynamic table.
+		void insert(hpack_field const& field);
+
+		/// \brief Evict the oldest entries until the table fits into size.
+		void evict(std::size_t size);
+
+		/// \brief Maximal size of the dynamic table announced to the peer.
+		std::size_t const max_table_size_;
+
+		/// \brief Maximal size of the fields of a header block, computed as
+		///        in SETTINGS_MAX_HEADER_LIST_SIZE.
+		std::size_t const max_list_size_;
+
+		/// \brief Current limit of the dynamic table set by the peer.
+		std::size_t table_limit_;
+
+		/// \brief Size of the entries of the dynamic table.
+		std::size_t table_size_ = 0;
+
+		/// \brief The dynamic table, newest entry first.
+		std::deque< hpack_field > table_;
+	};
+
+
+	/// \brief Append a field to an HTTP/2 header block (HPACK, RFC 7541).
+	///
+	/// The field is encoded by the static table or as literal without
+	/// indexing, so the dynamic table of the peer's decoder stays empty and
+	/// blocks may be sent in any order. The name must be lower case.
+	void hpack_encode(
+		std::string& block,
+		std::string_view name,
+		std::string_view value
+	);
+
+
+}
+
+
+#endif
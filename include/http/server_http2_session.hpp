@@ -0,0 +1,395 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#ifndef _http__server_http2_session__hpp_INCLUDED_
+#define _http__server_http2_session__hpp_INCLUDED_
+
+#include "reply.hpp"
+#include "request.hpp"
+#include "server_connection.hpp"
+#include "server_connection_manager.hpp"
+#include "server_hpack.hpp"
+#include "server_options.hpp"
+#include "server_request_handler.hpp"
+
+#include <boost/noncopyable.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+
+namespace http::server{
+
+
+	/// \brief Serves an HTTP/2 connection (RFC 7540) after it was taken
+	///        over from HTTP/1.
+	///
+	/// Every stream is passed to request_handler::async_handle_request()
+	/// as a request with HTTP version 2.0 and header names in HTTP/1
+	/// spelling ("content-type" becomes "Content-Type"). The replies of
+	/// concurrent streams are sent as they complete, interleaved by the
+	/// flow control windows of the client. Handlers must not take over the
+	/// connection of a stream. Server push and priorities are not
+	/// supported.
+	///
+	/// All member functions are called within the strand of the connection.
+	class http2_session final:
+		private boost::noncopyable,
+		public std::enable_shared_from_this< http2_session >{
+	public:
+		/// \brief Construct for a connection, whose requests are handled by
+		///        handler.
+		///
+		/// Every stream is counted as request by connection_manager.
+		http2_session(
+			connection_ptr connection,
+			request_handler& handler,
+			http::server::connection_manager& connection_manager,
+			options const& options
+		);
+
+		/// \brief Start after the HTTP/1 parser has read the request line
+		///        "PRI * HTTP/2.0" of the client preface.
+		void start();
+
+		/// \brief Start after "101 Switching Protocols" has been sent to
+		///        an "Upgrade: h2c" request, it is answered as stream 1.
+		///
+		/// settings is the value of the HTTP2-Settings header field.
+		void start(http::request req, std::string const& settings);
+
+		/// \brief Send GOAWAY, refuse new streams and close the connection
+		///        after the open ones.
+		void shutdown();
+
+
+	private:
+		/// \brief Error codes of RST_STREAM and GOAWAY frames.
+		enum error_code_type: std::uint32_t{
+			no_error = 0x0,
+			protocol_error = 0x1,
+			internal_error = 0x2,
+			flow_control_error = 0x3,
+			stream_closed = 0x5,
+			frame_size_error = 0x6,
+			refused_stream = 0x7,
+			compression_error = 0x9,
+			enhance_your_calm = 0xb
+		};
+
+		/// \brief The 9 byte header of a frame.
+		struct frame_header{
+			std::uint32_t length;
+			std::uint8_t type;
+			std::uint8_t flags;
+			std::uint32_t stream_id;
+		};
+
+		/// \brief State of a stream.
+		struct stream{
+			/// \brief Identifier of the stream.
+			std::uint32_t id;
+
+			/// \brief The request of the client.
+			http::request req;
+
+			/// \brief The reply of the handler.
+			http::reply rep;
+
+			/// \brief Receives the body, if the request handler streams it.
+			body_fn body_callback;
+
+			/// \brief Bytes the server may send.
+			std::int64_t send_window;
+
+			/// \brief Bytes the client may send.
+			std::int64_t receive_window;
+
+			/// \brief Received bytes not yet announced by WINDOW_UPDATE.
+			std::size_t received = 0;
+
+			/// \brief true after END_STREAM of the client.
+			bool remote_closed = false;
+
+			/// \brief true after the request was passed to the handler or
+			///        was answered without it, the rest of the body is
+			///        discarded.
+			bool dispatched = false;
+
+			/// \brief true while the handler has not completed the reply.
+			bool handling = false;
+
+			/// \brief true after the HEADERS of the reply.
+			bool replied = false;
+
+			/// \brief true after RST_STREAM or END_STREAM of the reply.
+			bool closed = false;
+
+			/// \brief The reply body not yet sent.
+			std::string data;
+
+			/// \brief Count of bytes of data already sent.
+			std::size_t data_sent = 0;
+
+			/// \brief true while rep.producer produces further pieces.
+			bool producing = false;
+		};
+
+		using stream_ptr = std::shared_ptr< stream >;
+
+
+		/// \brief Wait for the next data of the client.
+		void read();
+
+		/// \brief Handle the received data.
+		///
+		/// \return Count of consumed bytes, an incomplete frame is kept
+		std::size_t receive(std::string_view data, error_code const& err);
+
+		/// \brief Handle a complete frame.
+		///
+		/// \return false after a connection error
+		bool handle_frame(frame_header const& header, std::string_view data);
+
+		/// \brief Handle a DATA frame.
+		bool handle_data(frame_header const& header, std::string_view data);
+
+		/// \brief Handle a HEADERS frame.
+		bool handle_headers(
+			frame_header const& header,
+			std::string_view data
+		);
+
+		/// \brief Handle a CONTINUATION frame.
+		bool handle_continuation(
+			frame_header const& header,
+			std::string_view data
+		);
+
+		/// \brief Handle a RST_STREAM frame.
+		bool handle_rst_stream(
+			frame_header const& header,
+			std::string_view data
+		);
+
+		/// \brief Handle a SETTINGS frame.
+		bool handle_settings(
+			frame_header const& header,
+			std::string_view data
+		);
+
+		/// \brief Apply the settings of a SETTINGS frame payload.
+		bool apply_settings(std::string_view data);
+
+		/// \brief Handle a PING frame.
+		bool handle_ping(frame_header const& header, std::string_view data);
+
+		/// \brief Handle a GOAWAY frame.
+		bool handle_goaway(
+			frame_header const& header,
+			std::string_view data
+		);
+
+		/// \brief Handle a WINDOW_UPDATE frame.
+		bool handle_window_update(
+			frame_header const& header,
+			std::string_view data
+		);
+
+		/// \brief Decode the complete header block of header_stream_.
+		bool finish_headers();
+
+		/// \brief Open a stream for the decoded request header.
+		///
+		/// If too_large is set, the fields exceeded the maximal header list
+		/// size and were dropped.
+		void open_stream(
+			std::uint32_t id,
+			hpack_field_list& fields,
+			bool too_large
+		);
+
+		/// \brief Fill the request of a stream by the decoded fields.
+		///
+		/// \return false if the request is malformed
+		bool make_request(http::request& req, hpack_field_list& fields);
+
+		/// \brief Pass the request of a stream to the handler.
+		void handle_request(stream_ptr const& stream);
+
+		/// \brief Called within the strand, when the handler has completed
+		///        the reply of a stream.
+		void complete_request(stream_ptr const& stream);
+
+		/// \brief Answer a stream with a stock reply without the handler.
+		void fail_request(stream_ptr const& stream, reply::status_type status);
+
+		/// \brief Answer a stream with rep without the handler.
+		void fail_request(stream_ptr const& stream, http::reply rep);
+
+		/// \brief Send the HEADERS of the reply of a stream and start to
+		///        send its body.
+		void send_reply(stream_ptr const& stream);
+
+		/// \brief Send as much of the reply body of a stream as the flow
+		///        control windows allow.
+		void send_data(stream_ptr const& stream);
+
+		/// \brief Continue the reply bodies of all streams.
+		void send_all();
+
+		/// \brief Close a stream after the END_STREAM of its reply.
+		void finish_stream(stream_ptr const& stream);
+
+		/// \brief Close a stream by RST_STREAM.
+		void reset_stream(stream_ptr const& stream, error_code_type error);
+
+		/// \brief Append a RST_STREAM frame to the output.
+		void send_rst_stream(stream const& stream, error_code_type error);
+
+		/// \brief Send GOAWAY after the last stream, if the server drains.
+		void close_if_drained();
+
+		/// \brief Set the timeout of the connection for the current state.
+		///
+		/// The client preface must arrive within options::header_timeout, a
+		/// connection without streams is closed after
+		/// options::idle_timeout.
+		void update_timeout();
+
+		/// \brief Count the consumed bytes of a DATA frame and extend the
+		///        receive windows by WINDOW_UPDATE if they fall below half.
+		void consume(stream* stream, std::size_t size);
+
+		/// \brief Send the SETTINGS of the server and extend the receive
+		///        window of the connection.
+		void send_settings();
+
+		/// \brief Send GOAWAY and close the connection after it.
+		///
+		/// \return false
+		bool connection_error(error_code_type error);
+
+		/// \brief Append a GOAWAY frame with last_stream_id_ to the output.
+		void send_goaway(error_code_type error);
+
+		/// \brief Append a frame to the output.
+		void write_frame(
+			std::uint8_t type,
+			std::uint8_t flags,
+			std::uint32_t stream_id,
+			std::string_view payload
+		);
+
+		/// \brief Write the output frames.
+		void flush();
+
+		/// \brief Handle completion of a write operation.
+		void handle_write(error_code const& err);
+
+		/// \brief true if the reply bodies must wait for written data.
+		bool backpressure()const;
+
+		/// \brief The connection the session has taken over.
+		connection_ptr const connection_;
+
+		/// \brief The handler for all incoming requests.
+		request_handler& request_handler_;
+
+		/// \brief Counts the requests of the server.
+		http::server::connection_manager& connection_manager_;
+
+		/// \brief Configuration of the server.
+		options const& options_;
+
+		/// \brief Rest of the client preface, that is still expected.
+		std::string_view preface_;
+
+		/// \brief true after the first SETTINGS frame of the client.
+		bool settings_received_ = false;
+
+		/// \brief Decoder of the request header blocks.
+		hpack_decoder decoder_;
+
+		/// \brief The open streams.
+		std::map< std::uint32_t, stream_ptr > streams_;
+
+		/// \brief Count of streams reset by the client, whose handler has
+		///        not yet completed, they count as open.
+		std::size_t orphaned_streams_ = 0;
+
+		/// \brief Count of streams reset by the client.
+		std::size_t client_resets_ = 0;
+
+		/// \brief Streams the server has reset while the client could still
+		///        send, frames in flight on them are ignored.
+		std::deque< std::uint32_t > reset_streams_;
+
+		/// \brief Highest stream identifier the client has used.
+		std::uint32_t last_stream_id_ = 0;
+
+		/// \brief Stream of the header block, that is continued by
+		///        CONTINUATION frames, 0 if none.
+		std::uint32_t continuation_stream_ = 0;
+
+		/// \brief Stream of the header block in header_block_.
+		std::uint32_t header_stream_ = 0;
+
+		/// \brief true if the HEADERS frame in header_block_ has
+		///        END_STREAM.
+		bool header_end_stream_ = false;
+
+		/// \brief The header block of the current HEADERS frame and its
+		///        CONTINUATION frames.
+		std::string header_block_;
+
+		/// \brief Bytes of reply bodies the server may send.
+		std::int64_t send_window_ = 65535;
+
+		/// \brief Bytes of request bodies the client may send.
+		std::int64_t receive_window_ = 65535;
+
+		/// \brief Received bytes not yet announced by WINDOW_UPDATE.
+		std::size_t received_ = 0;
+
+		/// \brief Initial send window of new streams.
+		std::int64_t initial_send_window_ = 65535;
+
+		/// \brief Maximal payload size of frames sent to the client.
+		std::size_t max_frame_size_ = 16384;
+
+		/// \brief true after GOAWAY by shutdown(), new streams are refused.
+		bool going_away_ = false;
+
+		/// \brief true while the idle timeout runs, empty while the client
+		///        preface is expected.
+		std::optional< bool > idle_;
+
+		/// \brief true after a connection error, nothing is read anymore.
+		bool closing_ = false;
+
+		/// \brief true after the connection has failed.
+		bool closed_ = false;
+
+		/// \brief true while reply bodies wait for written data.
+		bool blocked_ = false;
+
+		/// \brief Frames not yet passed to the connection.
+		std::string output_;
+	};
+
+
+}
+
+
+#endif
@@ -0,0 +1,315 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#ifndef _http__server_options__hpp_INCLUDED_
+#define _http__server_options__hpp_INCLUDED_
+
+#include <boost/asio/socket_base.hpp>
+#include <boost/version.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace http::server{
+
+
+	/// \brief How the I/O threads of the server share the work.
+	enum class execution_mode{
+		/// \brief All threads run one io_service, the handlers of a
+		///        connection are serialized by a strand.
+		shared,
+
+		/// \brief Every thread runs its own io_service with its own
+		///        SO_REUSEPORT acceptor, connections never change the thread.
+		sharded
+	};
+
+
+	/// \brief The mechanism asio uses for socket I/O.
+	///
+	/// Asio selects it at compile time, io_uring is used if the library is
+	/// built with BOOST_ASIO_HAS_IO_URING and BOOST_ASIO_DISABLE_EPOLL
+	/// (Boost 1.78 or later).
+	enum class io_backend{
+		/// \brief Readiness based reactor (epoll, kqueue, select).
+		reactor,
+
+		/// \brief Completion based Linux io_uring.
+		io_uring
+	};
+
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+#if BOOST_VERSION < 107800
+#error "io_uring backend requires Boost 1.78"
+#endif
+	/// \brief The backend asio is built with.
+	inline constexpr io_backend compiled_io_backend = io_backend::io_uring;
+#else
+	/// \brief The backend asio is built with.
+	inline constexpr io_backend compiled_io_backend = io_backend::reactor;
+#endif
+
+
+	/// \brief What the server does, when the connection limit is reached.
+	enum class overload_policy{
+		/// \brief Accept and answer new connections with a 503 reply.
+		reject,
+
+		/// \brief Leave new connections in the listen backlog, until a
+		///        connection is closed.
+		pause_accept
+	};
+
+
+	/// \brief Tuning of the listening and the accepted TCP sockets.
+	///
+	/// Options the platform does not support are ignored, options the
+	/// kernel rejects are logged.
+	struct socket_options{
+		/// \brief Send small replies and frames without delay (disable
+		///        Nagle's algorithm).
+		bool tcp_no_delay = true;
+
+		/// \brief Wake up the server not before the client has sent data,
+		///        but at most after this time (TCP_DEFER_ACCEPT, Linux),
+		///        0 disables it.
+		std::chrono::seconds defer_accept = std::chrono::seconds(0);
+
+		/// \brief Length of the queue of TCP Fast Open requests
+		///        (TCP_FASTOPEN), 0 disables it.
+		int fast_open_queue = 0;
+
+		/// \brief Send buffer size (SO_SNDBUF), 0 keeps the system default.
+		int send_buffer_size = 0;
+
+		/// \brief Receive buffer size (SO_RCVBUF), 0 keeps the system
+		///        default.
+		int receive_buffer_size = 0;
+
+		/// \brief Acknowledge received data immediately (TCP_QUICKACK,
+		///        Linux), set on every accepted connection and again after
+		///        every read, since Linux doesn't keep it.
+		bool quick_ack = false;
+
+		/// \brief Detect dead peers by keepalive probes (SO_KEEPALIVE).
+		bool keep_alive = false;
+
+		/// \brief Idle time before the first keepalive probe
+		///        (TCP_KEEPIDLE), 0 keeps the system default.
+		std::chrono::seconds keep_alive_idle = std::chrono::seconds(0);
+
+		/// \brief Time between keepalive probes (TCP_KEEPINTVL), 0 keeps
+		///        the system default.
+		std::chrono::seconds keep_alive_interval = std::chrono::seconds(0);
+
+		/// \brief Count of unanswered keepalive probes until the
+		///        connection is dropped (TCP_KEEPCNT), 0 keeps the system
+		///        default.
+		int keep_alive_count = 0;
+	};
+
+
+	/// \brief Configuration of the server and its connections.
+	struct options{
+		/// \brief Keep connections open for further requests
+		///        (HTTP/1.1 persistent connections).
+		bool keep_alive = true;
+
+		/// \brief Maximal count of requests served over one connection,
+		///        0 means unlimited.
+		std::size_t max_requests_per_connection = 100;
+
+		/// \brief Maximal count of pipelined requests, whose replies are
+		///        sent with a single write operation.
+		std::size_t max_pipelined_requests = 16;
+
+		/// \brief How the I/O threads of the server share the work.
+		execution_mode mode = execution_mode::shared;
+
+		/// \brief The required I/O backend, the server constructor throws
+		///        if the library is built with another one.
+		io_backend backend = compiled_io_backend;
+
+		/// \brief Time an idle I/O thread polls for ready handlers before it
+		///        blocks, 0 disables busy polling.
+		///
+		/// Trades CPU time for wake-up latency, best used with
+		/// execution_mode::sharded and pinned threads.
+		std::chrono::microseconds busy_poll = std::chrono::microseconds(0);
+
+		/// \brief Time the kernel busy polls the device queue on a blocking
+		///        receive of a connection (SO_BUSY_POLL), 0 disables it,
+		///        only supported on Linux.
+		std::chrono::microseconds socket_busy_poll =
+			std::chrono::microseconds(0);
+
+		/// \brief CPUs of the I/O threads, thread i runs on the CPUs
+		///        io_thread_cpus[i % io_thread_cpus.size()], empty means no
+		///        pinning, only supported on Linux.
+		std::vector< std::vector< unsigned > > io_thread_cpus;
+
+		/// \brief Accept connections in an own thread and hand them to the
+		///        io_services of the I/O threads round robin.
+		bool dedicated_accept_thread = false;
+
+		/// \brief CPUs of the accept thread, empty means no pinning, only
+		///        supported on Linux.
+		std::vector< unsigned > accept_thread_cpus;
+
+		/// \brief Prefix of the thread names, the I/O threads are named
+		///        "<prefix>-io-<i>", the accept thread "<prefix>-accept".
+		///
+		/// Linux truncates the names to 15 characters.
+		std::string thread_name_prefix = "http";
+
+		/// \brief Tuning of the listening and the accepted sockets.
+		socket_options socket;
+
+		/// \brief Length of the queue of pending connections of every
+		///        listening socket.
+		int listen_backlog =
+			boost::asio::socket_base::max_listen_connections;
+
+		/// \brief Maximal count of connections accepted per wakeup of an
+		///        acceptor.
+		std::size_t max_accepts_per_wakeup = 64;
+
+		/// \brief Maximal count of closed connection objects kept for reuse
+		///        per io_service.
+		std::size_t connection_pool_size = 1024;
+
+		/// \brief Count of connection objects created on server start per
+		///        io_service.
+		std::size_t connection_pool_preallocate = 0;
+
+		/// \brief Initial size of the read buffer of a connection.
+		///
+		/// A connection borrows its read buffer from a pool of the I/O
+		/// thread only while it has received unprocessed data, waiting
+		/// connections hold no buffer.
+		std::size_t read_buffer_size = 8192;
+
+		/// \brief The read buffer grows up to this size while reads fill it
+		///        completely, and shrinks back if they don't.
+		std::size_t max_read_buffer_size = 64 * 1024;
+
+		/// \brief Maximal count of unused read buffers kept per I/O thread.
+		std::size_t read_buffer_pool_size = 256;
+
+		/// \brief Time to receive the header of a request, measured from
+		///        its first byte, 0 disables the timeout.
+		std::chrono::milliseconds header_timeout = std::chrono::seconds(30);
+
+		/// \brief Time the client may pause while sending a request body, 0
+		///        disables the timeout.
+		std::chrono::milliseconds body_timeout = std::chrono::seconds(30);
+
+		/// \brief Time a persistent connection may wait for the next
+		///        request, 0 disables the timeout.
+		std::chrono::milliseconds idle_timeout = std::chrono::seconds(60);
+
+		/// \brief Time to send a reply, 0 disables the timeout.
+		std::chrono::milliseconds write_timeout = std::chrono::seconds(30);
+
+		/// \brief Time to read and discard further data of the client
+		///        before a connection is closed after its last reply, 0
+		///        closes at once.
+		///
+		/// Unread data, e.g. a request body behind a 413 reply, makes the
+		/// kernel reset the connection, and the client may lose the reply.
+		std::chrono::milliseconds linger_timeout = std::chrono::seconds(2);
+
+		/// \brief Resolution of all timeouts.
+		std::chrono::milliseconds timer_resolution =
+			std::chrono::milliseconds(100);
+
+		/// \brief connection::write() signals backpressure, when more bytes
+		///        are queued, 0 means never.
+		std::size_t write_high_water_mark = 1024 * 1024;
+
+		/// \brief connection::write() fails, when more bytes would be
+		///        queued, 0 means unlimited.
+		std::size_t write_queue_limit = 16 * 1024 * 1024;
+
+		/// \brief Maximal count of bytes of queued write() calls, that are
+		///        gathered into a single write operation.
+		std::size_t write_gather_bytes = 256 * 1024;
+
+		/// \brief Maximal count of queued write() calls, that are gathered
+		///        into a single write operation.
+		std::size_t write_gather_buffers = 64;
+
+		/// \brief Hold back partial TCP segments while queued write() calls
+		///        are written (TCP_CORK), only supported on Linux.
+		bool cork_writes = false;
+
+		/// \brief Time the destructor of the server waits for open
+		///        connections before it closes them.
+		std::chrono::milliseconds shutdown_timeout = std::chrono::seconds(30);
+
+		/// \brief Maximal size of a request body, that is buffered into
+		///        request::body.
+		///
+		/// Larger bodies are answered with 413 unless the request_handler
+		/// streams them.
+		std::size_t max_body_size = 1024 * 1024;
+
+		/// \brief Maximal length of the extensions of a chunk of a chunked
+		///        request body.
+		std::size_t max_chunk_extension_size = 1024;
+
+		/// \brief Maximal length of the trailer of a chunked request body.
+		std::size_t max_trailer_size = 8192;
+
+		/// \brief Accept HTTP/2 over cleartext TCP (h2c), by prior knowledge
+		///        and by "Upgrade: h2c".
+		///
+		/// options::max_read_buffer_size must hold a frame of 16393 bytes.
+		bool http2 = true;
+
+		/// \brief Maximal count of concurrent streams of an HTTP/2
+		///        connection.
+		std::size_t http2_max_concurrent_streams = 100;
+
+		/// \brief Flow control window for the request bodies of an HTTP/2
+		///        connection and of each of its streams, at least 65535.
+		std::size_t http2_initial_window_size = 1024 * 1024;
+
+		/// \brief Maximal size of the header fields of an HTTP/2 request,
+		///        counted as by SETTINGS_MAX_HEADER_LIST_SIZE.
+		std::size_t http2_max_header_list_size = 64 * 1024;
+
+		/// \brief Maximal count of streams a client may reset on an HTTP/2
+		///        connection, 0 means unlimited.
+		///
+		/// The connection is closed with ENHANCE_YOUR_CALM if it is
+		/// exceeded.
+		std::size_t http2_max_resets = 1000;
+
+		/// \brief Maximal count of open connections, 0 means unlimited.
+		std::size_t max_connections = 0;
+
+		/// \brief Maximal count of requests in process, further requests are
+		///        answered with 503, 0 means unlimited.
+		std::size_t max_inflight_requests = 0;
+
+		/// \brief What the server does, when max_connections is reached.
+		overload_policy overload = overload_policy::reject;
+
+		/// \brief Value of the Retry-After header of 503 replies.
+		std::chrono::seconds retry_after = std::chrono::seconds(1);
+	};
+
+
+}
+
+
+#endif
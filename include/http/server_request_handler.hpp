@@ -11,7 +11,9 @@
 
 #include <boost/noncopyable.hpp>
 
+#include <functional>
 #include <string>
+#include <string_view>
 #include <memory>
 
 
@@ -32,6 +34,13 @@ namespace http::server{
 
 	using connection_ptr = std::shared_ptr< connection >;
 
+	/// \brief Receives the next part of a request body, returns false to
+	///        stop receiving it.
+	using body_fn = std::function< bool(std::string_view data) >;
+
+	/// \brief Completes the reply of async_handle_request().
+	using complete_fn = std::function< void() >;
+
 	/// \brief The common handler for all incoming requests.
 	class request_handler: private boost::noncopyable{
 	public:
@@ -45,6 +54,60 @@ namespace http::server{
 			http::reply& rep
 		) = 0;
 
+		/// \brief Handle a request and produce the reply asynchronously.
+		///
+		/// The reply is sent after complete has been called, which may be
+		/// done from any thread and after this function has returned. Until
+		/// then the connection keeps req and rep alive and does not handle
+		/// further pipelined requests. complete must be called exactly once.
+		///
+		/// The default calls handle_request() and completes at once.
+		virtual void async_handle_request(
+			connection_ptr const& connection,
+			http::request const& req,
+			http::reply& rep,
+			complete_fn complete
+		){
+			handle_request(connection, req, rep);
+			complete();
+		}
+
+		/// \brief Decide if the client shall send the body of a request
+		///        with "Expect: 100-continue".
+		///
+		/// Is called after the header. If true is returned, the server sends
+		/// "100 Continue" and receives the body. Otherwise rep is sent as
+		/// the final reply, it is preset with 417, and the connection is
+		/// closed after it. Bodies larger than options::max_body_size are
+		/// answered with 413 before the handler is asked.
+		virtual bool check_continue(
+			connection_ptr const& /*connection*/,
+			http::request const& /*req*/,
+			http::reply& /*rep*/
+		){
+			return true;
+		}
+
+		/// \brief Decide how the body of a request is received.
+		///
+		/// Is called after the header of a request with a body. An empty
+		/// function buffers the body into req.body, bodies larger than
+		/// options::max_body_size are answered with 413 then.
+		///
+		/// Otherwise the function gets the body part by part as it arrives
+		/// and handle_request() is called with an empty req.body after the
+		/// last part. Chunked bodies are passed decoded, the fields of their
+		/// trailer are added to req.headers.
+		///
+		/// If the function returns false, handle_request() is called at once
+		/// and the connection is closed after the reply.
+		virtual body_fn stream_body(
+			connection_ptr const& /*connection*/,
+			http::request const& /*req*/
+		){
+			return body_fn();
+		}
+
 		/// \brief Is called by server shutdown
 		virtual void shutdown(){}
 	};
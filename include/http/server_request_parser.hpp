@@ -28,6 +28,15 @@ namespace http::server{
 		/// \brief Reset to initial parser state.
 		void reset();
 
+		/// \brief true if no byte of a request has been parsed since
+		///        construction or reset().
+		bool initial()const;
+
+		/// \brief Perform URL-decoding on a string.
+		///
+		/// Returns false if the encoding was invalid.
+		static bool url_decode(std::string const& in, std::string& out);
+
 		/// \brief Parse some data.
 		///
 		/// The tribool return value is true when a complete request has been
@@ -67,11 +76,6 @@ namespace http::server{
 		/// \brief Check if a byte is a digit.
 		static bool is_digit(int c);
 
-		/// \brief Perform URL-decoding on a string.
-		///
-		/// Returns false if the encoding was invalid.
-		static bool url_decode(std::string const& in, std::string& out);
-
 		/// \brief The current state of the parser.
 		enum state{
 			method_start,
@@ -10,15 +10,21 @@
 #define _http__server_server__hpp_INCLUDED_
 
 #include "server_connection.hpp"
+#include "server_connection_manager.hpp"
+#include "server_connection_pool.hpp"
+#include "server_options.hpp"
 #include "server_request_handler.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/noncopyable.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <vector>
 #include <future>
 #include <mutex>
+#include <optional>
 
 
 namespace http::server{
@@ -27,29 +33,195 @@ namespace http::server{
 	/// \brief The top-level class of the HTTP server.
 	class server: private boost::noncopyable{
 	public:
+		/// \brief Counters of a drain() call
+		struct drain_statistics{
+			/// \brief Count of open connections when drain() was called
+			std::size_t connections = 0;
+
+			/// \brief Count of requests in process when drain() was called
+			std::size_t requests = 0;
+
+			/// \brief Count of connections closed before the deadline
+			std::size_t closed = 0;
+
+			/// \brief Count of connections closed at the deadline
+			std::size_t forced = 0;
+		};
+
+
 		/// \brief Construct the server to listen on the specified TCP port.
 		server(
 			std::string const& port,
 			http::server::request_handler& handler,
-			std::size_t thread_pool_size
+			std::size_t thread_pool_size,
+			http::server::options const& options = http::server::options()
 		);
 
-		/// \brief Tell all handlers, that the server shutdowns
+		/// \brief Construct the server to listen on all specified endpoints.
+		///
+		/// An endpoint is a port ("8080"), an address with port
+		/// ("127.0.0.1:8080", "[::1]:8080"), a host name with port
+		/// ("localhost:8080") or the path of a Unix domain socket
+		/// ("unix:/run/http.sock").
+		server(
+			std::vector< std::string > const& endpoints,
+			http::server::request_handler& handler,
+			std::size_t thread_pool_size,
+			http::server::options const& options = http::server::options()
+		);
+
+		/// \brief Drain the server with options::shutdown_timeout, if not
+		///        done before, and wait for all threads
 		~server();
 
 
+		/// \brief Stop accepting and close all connections gracefully
+		///
+		/// Tells the handler that the server shutdowns, closes all
+		/// connections, that wait for a request, and sends
+		/// "Connection: close" with every further reply. Connections that
+		/// are still open after the timeout are closed.
+		///
+		/// Must not be called by an I/O thread of the server.
+		drain_statistics drain(std::chrono::milliseconds timeout);
+
+
+		/// \brief Get the summed up counters of the connection pools.
+		connection_pool::statistics connection_pool_statistics()const;
+
+		/// \brief Get the socket options as reported by the first listening
+		///        socket.
+		///
+		/// The kernel may adjust values, e.g. Linux rounds defer_accept up
+		/// to whole retransmission timeouts. Accepted sockets inherit the
+		/// values on Linux, quick_ack is reported as configured.
+		socket_options effective_socket_options()const;
+
+		/// \brief Count of open connections.
+		std::size_t connections()const;
+
+		/// \brief Count of requests in process.
+		std::size_t inflight_requests()const;
+
+
 	private:
-		/// \brief Run the server's io_service loop.
+		/// \brief A listening TCP or Unix domain socket.
+		struct listen_socket:
+			asio::basic_socket_acceptor< stream_protocol >{
+			using basic_socket_acceptor::basic_socket_acceptor;
+
+			/// \brief true for TCP, false for a Unix domain socket.
+			bool tcp = true;
+
+			/// \brief Hand the accepted connections to all shards round
+			///        robin.
+			bool distribute = false;
+		};
+
+		/// \brief An io_service with its own acceptors.
+		///
+		/// In shared mode there is exactly one shard run by all threads, in
+		/// sharded mode every thread runs its own shard.
+		struct shard{
+			/// \brief Construct with a concurrency hint for the io_service.
+			shard(
+				int concurrency_hint,
+				http::server::options const& options,
+				http::server::connection_manager& connection_manager
+			);
+
+			/// \brief The io_service used to perform asynchronous
+			///        operations.
+			asio::io_service io_service;
+
+			/// \brief Timeouts of the connections of the io_service.
+			timer_wheel timers;
+
+			/// \brief Recycles the connections of the io_service.
+			std::shared_ptr< connection_pool > pool;
+
+			/// \brief Acceptors used to listen for incoming connections, one
+			///        per endpoint.
+			std::vector< listen_socket > acceptors;
+
+			/// \brief Thread synchronization.
+			std::mutex acceptor_mutex;
+
+			/// \brief Keeps the io_service running while it has no
+			///        acceptors and during drain().
+			std::optional< asio::io_service::work > work;
+		};
+
+		/// \brief Listen on a TCP endpoint with all listening shards.
+		///
+		/// endpoints are all endpoints of the server, empty for Unix domain
+		/// sockets.
+		void listen_tcp(
+			tcp::endpoint const& endpoint,
+			std::vector< std::optional< tcp::endpoint > > const& endpoints
+		);
+
+		/// \brief Listen on a Unix domain socket with the first listening
+		///        shard.
+		void listen_unix(std::string const& path);
+
+		/// \brief Open, bind and listen with a new acceptor of a shard.
+		listen_socket& listen(
+			shard& shard,
+			stream_protocol::endpoint const& endpoint,
+			bool tcp,
+			bool v6_only
+		);
+
+		/// \brief Run the server's io_service loops.
 		void run(std::size_t thread_pool_size);
 
+		/// \brief Run an io_service, with busy polling if configured.
+		void run_io_service(asio::io_service& io_service);
+
+		/// \brief The shard that runs the connections accepted by an
+		///        acceptor of a listening shard.
+		shard& connection_shard(shard& listener, listen_socket& acceptor);
+
 		/// \brief Initiate an asynchronous accept operation.
-		void start_accept();
+		///
+		/// The new_connection is used for the next connection if given.
+		void start_accept(
+			shard& shard,
+			listen_socket& acceptor,
+			connection_ptr new_connection = connection_ptr()
+		);
+
+		/// \brief Stop asynchronous accept operations.
+		void stop_accept(shard& shard);
+
+		/// \brief Start a connection if the connection_manager_ admits it,
+		///        otherwise reject it.
+		void admit(
+			listen_socket const& acceptor,
+			connection_ptr const& new_connection
+		);
+
+		/// \brief Set the socket options of a connection accepted by the
+		///        acceptor.
+		void configure_socket(
+			listen_socket const& acceptor,
+			stream_protocol::socket& socket
+		);
 
-		/// \brief Stop asynchronous accept operation.
-		void stop_accept();
+		/// \brief Send the overload reply without blocking and close the
+		///        connection.
+		void reject(connection_ptr const& new_connection);
+
+		/// \brief Resume all acceptors paused by overload.
+		void resume_accept();
 
 		/// \brief Handle completion of an asynchronous accept operation.
+		///
+		/// Accepts all further pending connections without waiting.
 		void handle_accept(
+			shard& shard,
+			listen_socket& acceptor,
 			connection_ptr const& new_connection,
 			error_code const& err
 		);
@@ -57,14 +229,52 @@ namespace http::server{
 		/// \brief The handler for all incoming requests.
 		http::server::request_handler& request_handler_;
 
-		/// \brief The io_service used to perform asynchronous operations.
-		asio::io_service io_service_;
+		/// \brief Configuration of the server and its connections.
+		http::server::options const options_;
+
+		/// \brief Counts the connections and requests of all shards.
+		http::server::connection_manager connection_manager_;
+
+		/// \brief An acceptor that waits until a connection is closed.
+		struct paused_acceptor{
+			/// \brief Shard of the acceptor.
+			server::shard& shard;
+
+			/// \brief The paused acceptor.
+			listen_socket& acceptor;
+
+			/// \brief Connection for the next accept operation.
+			connection_ptr next_connection;
+		};
+
+		/// \brief Protect paused_acceptors_ and stopped_.
+		std::mutex paused_mutex_;
+
+		/// \brief Acceptors paused by overload.
+		std::vector< paused_acceptor > paused_acceptors_;
+
+		/// \brief true if the server does not accept connections anymore.
+		bool stopped_ = false;
+
+		/// \brief true if drain() was called.
+		std::atomic< bool > drained_{false};
+
+		/// \brief The io_services of the connections.
+		std::vector< std::unique_ptr< shard > > shards_;
+
+		/// \brief The io_service of the dedicated accept thread.
+		std::unique_ptr< shard > accept_shard_;
+
+		/// \brief The shards with acceptors.
+		std::vector< shard* > listeners_;
 
-		/// \brief Acceptor used to listen for incoming connections.
-		tcp::acceptor acceptor_;
+		/// \brief Index of the shard of the next connection accepted by
+		///        accept_shard_ or a distributing acceptor.
+		std::atomic< std::size_t > next_shard_{0};
 
-		/// \brief Thread synchronization.
-		std::mutex acceptor_mutex_;
+		/// \brief Paths of the Unix domain sockets, removed by the
+		///        destructor.
+		std::vector< std::string > unix_paths_;
 
 		/// \brief The working threads.
 		std::vector< std::future< void > > futures_;
@@ -0,0 +1,168 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#ifndef _http__server_timer_wheel__hpp_INCLUDED_
+#define _http__server_timer_wheel__hpp_INCLUDED_
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+
+namespace http{
+
+
+	namespace asio = boost::asio;
+
+
+}
+
+
+namespace http::server{
+
+
+	/// \brief Hierarchical timer wheel for the timeouts of many connections.
+	///
+	/// One asio timer drives all entries of an io_service. Scheduling and
+	/// cancelling an entry is O(1), the resolution of the timeouts is one
+	/// tick.
+	class timer_wheel: private boost::noncopyable{
+	public:
+		using clock = std::chrono::steady_clock;
+
+
+		/// \brief A timeout in the wheel.
+		///
+		/// The owner must outlive the scheduled entry, the destructor
+		/// cancels it.
+		class entry: private boost::noncopyable{
+		public:
+			/// \brief Construct an unscheduled entry.
+			entry() = default;
+
+			/// \brief Cancel the entry.
+			~entry();
+
+			/// \brief Set the function, that is called on expiry.
+			///
+			/// The function is called by an io_service thread outside of any
+			/// strand.
+			void callback(std::function< void() > callback);
+
+			/// \brief true if the entry is scheduled.
+			bool scheduled()const{ return wheel_ != nullptr; }
+
+		private:
+			friend class timer_wheel;
+
+			/// \brief The wheel the entry is scheduled in.
+			timer_wheel* wheel_ = nullptr;
+
+			/// \brief The slot the entry is in.
+			entry** slot_ = nullptr;
+
+			/// \brief Previous entry in the slot.
+			entry* prev_ = nullptr;
+
+			/// \brief Next entry in the slot.
+			entry* next_ = nullptr;
+
+			/// \brief Tick of expiry.
+			std::uint64_t expiry_ = 0;
+
+			/// \brief Is called on expiry.
+			std::function< void() > callback_;
+		};
+
+
+		/// \brief Construct a wheel with the given tick length.
+		timer_wheel(asio::io_service& io_service, clock::duration resolution);
+
+		/// \brief Stop the timer.
+		~timer_wheel();
+
+		/// \brief Schedule the entry to expire after timeout.
+		///
+		/// A scheduled entry is rescheduled.
+		void schedule(entry& entry, clock::duration timeout);
+
+		/// \brief Remove the entry from the wheel.
+		void cancel(entry& entry);
+
+
+	private:
+		/// \brief Bits of the slot index per level.
+		static constexpr std::size_t slot_bits = 6;
+
+		/// \brief Count of slots per level.
+		static constexpr std::size_t slot_count = 1 << slot_bits;
+
+		/// \brief Count of levels, with 100 ms ticks the wheel covers more
+		///        than 19 days.
+		static constexpr std::size_t level_count = 4;
+
+		/// \brief Get the tick of a time point.
+		std::uint64_t tick(clock::time_point time)const;
+
+		/// \brief Put an entry into the slot of its expiry tick.
+		void insert(entry& entry);
+
+		/// \brief Remove an entry from its slot.
+		void unlink(entry& entry);
+
+		/// \brief Move all entries of the current slot of a level to the
+		///        lower levels.
+		void cascade(std::size_t level);
+
+		/// \brief Wait for the next tick.
+		void arm();
+
+		/// \brief Process all ticks until now.
+		void handle_tick(boost::system::error_code const& err);
+
+		/// \brief Protect all data members.
+		std::mutex mutex_;
+
+		/// \brief The timer that drives the wheel.
+		asio::steady_timer timer_;
+
+		/// \brief Length of one tick.
+		clock::duration const resolution_;
+
+		/// \brief Time of tick 0.
+		clock::time_point const epoch_;
+
+		/// \brief The last processed tick.
+		std::uint64_t current_tick_ = 0;
+
+		/// \brief Count of scheduled entries.
+		std::size_t count_ = 0;
+
+		/// \brief true while the timer waits.
+		bool armed_ = false;
+
+		/// \brief First entry of every slot of every level.
+		std::array< std::array< entry*, slot_count >, level_count >
+			slots_{};
+
+		/// \brief Callbacks of the expired entries of one tick.
+		std::vector< std::function< void() > > expired_;
+	};
+
+
+}
+
+
+#endif
@@ -14,6 +14,7 @@
 
 #include <map>
 #include <mutex>
+#include <string_view>
 
 
 namespace http::websocket::server{
@@ -130,7 +131,7 @@ namespace http::websocket::server{
 		/// \brief Receives incomming data
 		void receive(
 			http::server::connection_ptr const& connection,
-			std::string const& data
+			std::string_view data
 		);
 
 		/// \brief Handles an incomming frame
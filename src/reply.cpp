@@ -105,6 +105,8 @@ namespace http{
 			"Requested range not satisfiable"),
 		make_mapping_pair(reply::expectation_failed,
 			"Expectation Failed"),
+		make_mapping_pair(reply::request_header_fields_too_large,
+			"Request Header Fields Too Large"),
 		// Server Error
 		make_mapping_pair(reply::internal_server_error,
 			internal_server_error),
@@ -159,6 +161,11 @@ namespace http{
 
 	std::vector< asio::const_buffer > reply::to_buffers() const{
 		std::vector< asio::const_buffer > buffers;
+		to_buffers(buffers);
+		return buffers;
+	}
+
+	void reply::to_buffers(std::vector< asio::const_buffer >& buffers) const{
 		buffers.emplace_back(status_strings::to_buffer(status));
 		for(auto const& header: headers){
 			buffers.emplace_back(asio::buffer(header.first));
@@ -168,8 +175,7 @@ namespace http{
 			buffers.emplace_back(asio::buffer(misc_strings::crlf));
 		}
 		buffers.emplace_back(asio::buffer(misc_strings::crlf));
-		buffers.emplace_back(asio::buffer(content));
-		return buffers;
+		if(!producer) buffers.emplace_back(asio::buffer(content));
 	}
 
 
@@ -221,5 +227,11 @@ namespace http{
 		return rep;
 	}
 
+	bool reply::has_body(status_type status){
+		return status >= 200
+			&& status != no_content
+			&& status != not_modified;
+	}
+
 
 }
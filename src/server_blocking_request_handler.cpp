@@ -0,0 +1,161 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#include <http/server_blocking_request_handler.hpp>
+
+#include <http/reply.hpp>
+#include <http/request.hpp>
+
+#include <logsys/log.hpp>
+#include <logsys/stdlogb.hpp>
+
+
+namespace http::server{
+
+
+	blocking_request_handler::blocking_request_handler(
+		request_handler& handler,
+		std::size_t thread_count,
+		std::size_t queue_size,
+		predicate_fn blocking,
+		std::chrono::seconds retry_after
+	):
+		handler_(handler),
+		queue_size_(queue_size),
+		blocking_(std::move(blocking)),
+		retry_after_(retry_after)
+	{
+		workers_.reserve(thread_count);
+		for(std::size_t i = 0; i < thread_count; ++i){
+			workers_.emplace_back([this]{ work(); });
+		}
+	}
+
+	blocking_request_handler::~blocking_request_handler(){
+		{
+			std::lock_guard< std::mutex > lock(mutex_);
+			stop_ = true;
+		}
+		ready_.notify_all();
+
+		for(auto& worker: workers_){
+			worker.join();
+		}
+	}
+
+	bool blocking_request_handler::handle_request(
+		connection_ptr const& connection,
+		http::request const& req,
+		http::reply& rep
+	){
+		return handler_.handle_request(connection, req, rep);
+	}
+
+	void blocking_request_handler::async_handle_request(
+		connection_ptr const& connection,
+		http::request const& req,
+		http::reply& rep,
+		complete_fn complete
+	){
+		if(blocking_ && !blocking_(req)){
+			handler_.async_handle_request(
+				connection, req, rep, std::move(complete));
+			return;
+		}
+
+		{
+			std::lock_guard< std::mutex > lock(mutex_);
+			if(!shutdown_ && queue_.size() < queue_size_){
+				queue_.push_back(
+					task{connection, req, rep, std::move(complete)});
+				ready_.notify_one();
+				return;
+			}
+
+			++rejected_;
+		}
+
+		// Shed the load without waiting
+		reject(rep);
+		complete();
+	}
+
+	bool blocking_request_handler::check_continue(
+		connection_ptr const& connection,
+		http::request const& req,
+		http::reply& rep
+	){
+		return handler_.check_continue(connection, req, rep);
+	}
+
+	body_fn blocking_request_handler::stream_body(
+		connection_ptr const& connection,
+		http::request const& req
+	){
+		return handler_.stream_body(connection, req);
+	}
+
+	void blocking_request_handler::shutdown(){
+		{
+			std::lock_guard< std::mutex > lock(mutex_);
+			shutdown_ = true;
+		}
+
+		handler_.shutdown();
+	}
+
+	std::size_t blocking_request_handler::queued()const{
+		std::lock_guard< std::mutex > lock(mutex_);
+		return queue_.size();
+	}
+
+	std::size_t blocking_request_handler::rejected()const{
+		std::lock_guard< std::mutex > lock(mutex_);
+		return rejected_;
+	}
+
+	void blocking_request_handler::work(){
+		for(;;){
+			std::unique_lock< std::mutex > lock(mutex_);
+			ready_.wait(lock, [this]{ return stop_ || !queue_.empty(); });
+
+			// Queued requests are finished before the workers stop
+			if(queue_.empty()) return;
+
+			auto task = std::move(queue_.front());
+			queue_.pop_front();
+			lock.unlock();
+
+			try{
+				handler_.handle_request(task.connection, task.req, task.rep);
+			}catch(std::exception const& error){
+				logsys::log([&error](logsys::stdlogb& os){
+					os << "Error: blocking_request_handler: " << error.what();
+				});
+				task.rep = http::reply::stock_reply(
+					http::reply::internal_server_error);
+			}catch(...){
+				logsys::log([](logsys::stdlogb& os){
+					os << "Error: blocking_request_handler: unknown exception";
+				});
+				task.rep = http::reply::stock_reply(
+					http::reply::internal_server_error);
+			}
+
+			task.complete();
+		}
+	}
+
+	void blocking_request_handler::reject(http::reply& rep)const{
+		rep = http::reply::stock_reply(http::reply::service_unavailable);
+		rep.headers.insert(std::make_pair("Retry-After",
+			std::to_string(retry_after_.count())));
+	}
+
+
+}
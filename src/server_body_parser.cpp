@@ -0,0 +1,275 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#include <http/server_body_parser.hpp>
+
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <limits>
+
+
+namespace http::server{
+
+
+	namespace{
+
+
+		/// \brief Parse a Content-Length value, false if it is invalid
+		bool parse_length(std::string const& value, std::uint64_t& length){
+			auto const text = boost::algorithm::trim_copy(value);
+			if(text.empty()) return false;
+
+			auto const max = std::numeric_limits< std::uint64_t >::max();
+			length = 0;
+			for(char c: text){
+				if(c < '0' || c > '9') return false;
+
+				std::uint64_t const digit = c - '0';
+				if(length > (max - digit) / 10) return false;
+				length = length * 10 + digit;
+			}
+
+			return true;
+		}
+
+		/// \brief Get the value of a hex digit, -1 if it is none
+		int hex_value(char c){
+			if(c >= '0' && c <= '9') return c - '0';
+			if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+			if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+			return -1;
+		}
+
+		/// \brief Check if a byte is an HTTP control character
+		bool is_ctl(char c){
+			return (c >= 0 && c <= 31) || c == 127;
+		}
+
+		/// \brief Fields that must not be sent in a trailer
+		/// (RFC 7230 4.1.2)
+		bool is_forbidden_trailer(std::string const& name){
+			for(char const* forbidden: {"Content-Length", "Transfer-Encoding",
+				"Trailer", "Host", "Content-Type", "Content-Encoding"}
+			){
+				if(boost::algorithm::iequals(name, forbidden)) return true;
+			}
+
+			return false;
+		}
+
+
+	}
+
+
+	body_parser::body_parser(options const& options):
+		options_(options)
+		{}
+
+	reply::status_type body_parser::start(http::request const& req){
+		reset();
+
+		bool has_length = false;
+		bool has_encoding = false;
+		for(auto const& field: req.headers){
+			if(boost::algorithm::iequals(field.first, "Transfer-Encoding")){
+				// Only chunked is supported, without further codings
+				auto const coding = boost::algorithm::trim_copy(field.second);
+				if(has_encoding
+					|| !boost::algorithm::iequals(coding, "chunked")
+				){
+					return reply::not_implemented;
+				}
+
+				has_encoding = true;
+				continue;
+			}
+
+			if(!boost::algorithm::iequals(field.first, "Content-Length")){
+				continue;
+			}
+
+			// Repeated fields must agree (RFC 7230 3.3.2)
+			std::uint64_t length;
+			if(!parse_length(field.second, length)
+				|| (has_length && length != content_length_)
+			){
+				return reply::bad_request;
+			}
+
+			has_length = true;
+			content_length_ = length;
+		}
+
+		// Both would allow request smuggling (RFC 7230 3.3.3)
+		if(has_encoding && has_length) return reply::bad_request;
+
+		if(has_encoding){
+			chunked_ = true;
+			state_ = chunk_size_start;
+		}else{
+			remaining_ = content_length_;
+			state_ = remaining_ > 0 ? content : done;
+		}
+
+		return reply::ok;
+	}
+
+	void body_parser::reset(){
+		state_ = done;
+		chunked_ = false;
+		content_length_ = 0;
+		remaining_ = 0;
+		extension_size_ = 0;
+		trailer_size_ = 0;
+		line_.clear();
+		trailers_.clear();
+	}
+
+	std::tuple< boost::tribool, std::string_view, char const* >
+	body_parser::parse(char const* begin, char const* end){
+		while(begin != end){
+			// The payload is passed without copying
+			if(state_ == content || state_ == chunk_data){
+				auto const size = static_cast< std::size_t >(
+					std::min< std::uint64_t >(remaining_, end - begin));
+				remaining_ -= size;
+
+				boost::tribool result = boost::indeterminate;
+				if(remaining_ == 0){
+					if(state_ == content){
+						state_ = done;
+						result = true;
+					}else{
+						state_ = chunk_data_cr;
+					}
+				}
+
+				return std::make_tuple(
+					result, std::string_view(begin, size), begin + size);
+			}
+
+			boost::tribool result = consume(*begin++);
+			if(result || !result){
+				return std::make_tuple(result, std::string_view(), begin);
+			}
+		}
+
+		boost::tribool result = boost::indeterminate;
+		return std::make_tuple(result, std::string_view(), begin);
+	}
+
+	boost::tribool body_parser::consume(char input){
+		switch(state_){
+		case chunk_size_start:{
+			auto const value = hex_value(input);
+			if(value < 0) return false;
+
+			remaining_ = value;
+			extension_size_ = 0;
+			state_ = chunk_size;
+			return boost::indeterminate;
+		}
+		case chunk_size:{
+			auto const value = hex_value(input);
+			if(value >= 0){
+				if(remaining_ > (std::numeric_limits< std::uint64_t >::max()
+					>> 4)) return false;
+
+				remaining_ = remaining_ * 16 + value;
+				return boost::indeterminate;
+			}else if(input == ';' || input == ' ' || input == '\t'){
+				state_ = chunk_extension;
+				return boost::indeterminate;
+			}else if(input == '\r'){
+				state_ = chunk_size_newline;
+				return boost::indeterminate;
+			}else{
+				return false;
+			}
+		}
+		case chunk_extension:
+			// Extensions are ignored
+			if(input == '\r'){
+				state_ = chunk_size_newline;
+				return boost::indeterminate;
+			}else if((is_ctl(input) && input != '\t')
+				|| ++extension_size_ > options_.max_chunk_extension_size
+			){
+				return false;
+			}else{
+				return boost::indeterminate;
+			}
+		case chunk_size_newline:
+			if(input != '\n') return false;
+
+			// The last chunk has size 0 and is followed by the trailer
+			state_ = remaining_ > 0 ? chunk_data : trailer_line_start;
+			return boost::indeterminate;
+		case chunk_data_cr:
+			if(input != '\r') return false;
+
+			state_ = chunk_data_newline;
+			return boost::indeterminate;
+		case chunk_data_newline:
+			if(input != '\n') return false;
+
+			state_ = chunk_size_start;
+			return boost::indeterminate;
+		case trailer_line_start:
+			if(input == '\r'){
+				state_ = final_newline;
+				return boost::indeterminate;
+			}
+
+			line_.clear();
+			state_ = trailer_line;
+			[[fallthrough]];
+		case trailer_line:
+			if(++trailer_size_ > options_.max_trailer_size) return false;
+
+			if(input == '\r'){
+				state_ = trailer_newline;
+			}else if(is_ctl(input) && input != '\t'){
+				return false;
+			}else{
+				line_.push_back(input);
+			}
+			return boost::indeterminate;
+		case trailer_newline:
+			if(input != '\n' || !add_trailer()) return false;
+
+			state_ = trailer_line_start;
+			return boost::indeterminate;
+		case final_newline:
+			if(input != '\n') return false;
+
+			state_ = done;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool body_parser::add_trailer(){
+		auto const colon = line_.find(':');
+		if(colon == 0 || colon == std::string::npos) return false;
+
+		auto name = line_.substr(0, colon);
+		if(name.find_first_of(" \t") != std::string::npos) return false;
+
+		// Fields that change the framing or routing are dropped
+		if(is_forbidden_trailer(name)) return true;
+
+		trailers_.emplace(std::move(name),
+			boost::algorithm::trim_copy(line_.substr(colon + 1)));
+		return true;
+	}
+
+
+}
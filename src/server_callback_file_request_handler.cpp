@@ -50,11 +50,21 @@ namespace http::server{
 			return false;
 		}
 
-		/// Set content length and mime type
+		auto const mime_type =
+			mime_types::extension_to_type(std::get< 0 >(file->second));
 		rep.status = reply::ok;
+
+		// The content is produced while it is sent
+		if(auto const& callback = std::get< 2 >(file->second)){
+			rep.producer = callback(req);
+			rep.headers.clear();
+			rep.headers.insert(make_pair("Content-Type", mime_type));
+			return true;
+		}
+
+		/// Set content length and mime type
 		rep.content = std::get< 1 >(file->second)(req);
-		set_http_header(rep,
-			mime_types::extension_to_type(std::get< 0 >(file->second)));
+		set_http_header(rep, mime_type);
 
 		return true;
 	}
@@ -67,7 +77,24 @@ namespace http::server{
 	){
 		if(files_.find(filename) != files_.end()) return false;
 
-		files_.insert(make_pair(filename, make_pair(mime_type, callback)));
+		files_.insert(make_pair(filename, std::make_tuple(mime_type, callback,
+			std::function< http::reply::producer_fn(
+				http::request const& req) >())));
+		return true;
+	}
+
+	/// Add a new virtual file, whose content is streamed
+	bool callback_file_request_handler::add_streamed(
+		std::string const& filename,
+		std::string const& mime_type,
+		std::function< http::reply::producer_fn(http::request const& req) >
+			const& callback
+	){
+		if(files_.find(filename) != files_.end()) return false;
+
+		files_.insert(make_pair(filename, std::make_tuple(mime_type,
+			std::function< std::string(http::request const& req) >(),
+			callback)));
 		return true;
 	}
 
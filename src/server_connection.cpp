@@ -8,155 +8,1099 @@
 //-----------------------------------------------------------------------------
 #include <http/server_connection.hpp>
 
+#include "server_socket_option.hpp"
+
+#include <http/server_http2_session.hpp>
 #include <http/server_request_handler.hpp>
 
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <sstream>
+
 
 namespace http::server{
 
 
-	connection::connection(asio::io_service& io_service):
-		strand_(io_service),
-		socket_(io_service)
-		{}
+	namespace{
+
+
+		/// \brief Check if a comma separated header field contains a token
+		bool has_token(
+			http::header const& headers,
+			std::string const& name,
+			std::string const& token
+		){
+			for(auto const& field: headers){
+				if(!boost::algorithm::iequals(field.first, name)) continue;
+
+				std::vector< std::string > tokens;
+				boost::algorithm::split(tokens, field.second,
+					boost::algorithm::is_any_of(","));
+				for(auto& value: tokens){
+					boost::algorithm::trim(value);
+					if(boost::algorithm::iequals(value, token)) return true;
+				}
+			}
+
+			return false;
+		}
+
+		/// \brief Check if a header field exists
+		bool has_field(http::header const& headers, std::string const& name){
+			for(auto const& field: headers){
+				if(boost::algorithm::iequals(field.first, name)) return true;
+			}
+
+			return false;
+		}
+
+		/// \brief Check if the request line is the start of the HTTP/2
+		///        client preface (RFC 7540 3.5)
+		bool is_http2_preface(http::request const& req){
+			return req.method == "PRI" && req.uri == "*"
+				&& req.http_version_major == 2 && req.http_version_minor == 0
+				&& req.headers.empty();
+		}
+
+		/// \brief Check if the client asks for HTTP/2 over cleartext TCP
+		///        (RFC 7540 3.2)
+		bool is_http2_upgrade(http::request const& req){
+			return req.http_version_major == 1 && req.http_version_minor >= 1
+				&& has_token(req.headers, "Upgrade", "h2c")
+				&& has_token(req.headers, "Connection", "HTTP2-Settings")
+				&& has_field(req.headers, "HTTP2-Settings");
+		}
+
+		/// \brief Refers to a vector of buffers without copying it
+		///
+		/// Write operations copy their buffer sequence, a vector would be
+		/// copied to the heap by every write.
+		class buffers_ref{
+		public:
+			using value_type = asio::const_buffer;
+			using const_iterator =
+				std::vector< asio::const_buffer >::const_iterator;
+
+			explicit buffers_ref(
+				std::vector< asio::const_buffer > const& buffers
+			):
+				buffers_(&buffers)
+				{}
+
+			const_iterator begin()const{ return buffers_->begin(); }
+			const_iterator end()const{ return buffers_->end(); }
+
+		private:
+			std::vector< asio::const_buffer > const* buffers_;
+		};
+
+		/// \brief Unused read buffers of one thread
+		struct read_buffer_pool{
+			/// \brief Size of the buffers
+			std::size_t size = 0;
+
+			/// \brief The buffers
+			std::vector< std::unique_ptr< char[] > > buffers;
+		};
+
+		/// \brief The read buffer pool of the calling thread
+		read_buffer_pool& thread_read_buffer_pool(){
+			thread_local read_buffer_pool pool;
+			return pool;
+		}
+
+		/// \brief Interim reply to "Expect: 100-continue"
+		std::string const continue_reply = "HTTP/1.1 100 Continue\r\n\r\n";
+
+		/// \brief End of a chunk and the last chunk of a chunked body
+		std::string const chunk_crlf = "\r\n";
+		std::string const last_chunk = "0\r\n\r\n";
+
+
+	}
+
+
+	connection::connection(
+		asio::io_service& io_service,
+		options const& options,
+		http::server::timer_wheel& timer_wheel,
+		http::server::connection_manager& connection_manager
+	):
+		io_service_(io_service),
+		socket_(io_service),
+		read_size_(options.read_buffer_size),
+		options_(options),
+		body_parser_(options),
+		timer_wheel_(timer_wheel),
+		deadline_(timer_wheel::clock::time_point::max()),
+		connection_manager_(connection_manager)
+	{
+		if(options_.mode == execution_mode::shared){
+			strand_.emplace(io_service_);
+		}
+	}
 
 	connection::~connection(){
 		// Initiate graceful connection closure.
 		error_code ignored_error;
-		socket_.shutdown(tcp::socket::shutdown_both, ignored_error);
+		socket_.shutdown(stream_protocol::socket::shutdown_both, ignored_error);
+
+		if(request_handler_){
+			connection_manager_.remove_requests(admitted_requests_);
+			connection_manager_.remove_connection(*this);
+		}
 	}
 
-	tcp::socket& connection::socket(){
+	stream_protocol::socket& connection::socket(){
 		return socket_;
 	}
 
 	void connection::start(request_handler& request_handler){
-		auto shared_this = shared_from_this();
+		request_handler_ = &request_handler;
+		replies_.reserve(options_.max_pipelined_requests);
 
-		/// The incoming request.
-		auto request = std::make_shared< http::request >();
+		// The timer wheel calls outside of the strand
+		weak_connection_ptr weak_this = shared_from_this();
+		timeout_.callback([weak_this]{
+			if(auto shared_this = weak_this.lock()){
+				shared_this->post([shared_this]{
+					shared_this->handle_timeout();
+				});
+			}
+		});
 
-		/// The parser for the incoming request.
-		auto request_parser =
-			std::make_shared< http::server::request_parser >();
+		// Waiting for the first request, the header timeout applies anyway
+		idle_ = true;
+		set_timeout(options_.header_timeout);
+		connection_manager_.register_connection(*this);
 
-		/// The reply to be sent back to the client.
-		auto reply = std::make_shared< http::reply >();
+		// Data is read after the socket became readable
+		error_code ignored_error;
+		socket_.non_blocking(true, ignored_error);
+		quick_ack_ = options_.socket.quick_ack;
+		do_read();
+	}
 
-		socket_.async_read_some(
-			asio::buffer(buffer_),
-			strand_.wrap(
-				[&request_handler, request, request_parser, reply, shared_this](
-					error_code const& err, std::size_t bytes_transferred
-				){
-					shared_this->handle_first_read(
-						request_handler, request, request_parser,
-						reply, err, bytes_transferred);
-				})
-		);
+	void connection::do_read(){
+		// No buffer is held while waiting
+		auto shared_this = shared_from_this();
+		async(read_memory_,
+			[this](auto handler){
+				socket_.async_wait(stream_protocol::socket::wait_read, handler);
+			},
+			[shared_this](error_code const& err){
+				shared_this->handle_read(err);
+			});
 	}
 
-	void connection::handle_first_read(
-		request_handler& request_handler,
-		std::shared_ptr< http::request > const& request,
-		std::shared_ptr< http::server::request_parser > const& request_parser,
-		std::shared_ptr< http::reply > const& reply,
-		error_code const& err,
-		std::size_t bytes_transferred
-	){
+	void connection::handle_read(error_code err){
+		if(!err) receive(err);
+
+		// Readiness may be spurious
+		if(err == asio::error::would_block){
+			do_read();
+			return;
+		}
+
 		if(!err){
+			// The first bytes of the next request
+			if(idle_){
+				idle_ = false;
+				set_timeout(options_.header_timeout);
+			}
+
+			// The body timeout measures the time without progress
+			if(body_parser_.active()){
+				set_timeout(options_.body_timeout);
+			}
+
+			handle_buffer();
+		}
+
+		// If an error occurs then no new asynchronous operations are started.
+		// This means that all shared_ptr references to the connection object
+		// will disappear and the object will be destroyed automatically after
+		// this handler returns. The connection class's destructor closes the
+		// socket.
+	}
+
+	void connection::handle_buffer(bool keep_alive){
+		auto shared_this = shared_from_this();
+
+		// Pipelined requests are answered in order by one write operation
+		while(keep_alive && !handling_ && buffer_begin_ != buffer_end_
+			&& (replies_.empty()
+				|| (replies_.size() < options_.max_pipelined_requests
+					&& !replies_.back().producer))
+		){
+			if(body_parser_.active()){
+				keep_alive = handle_body();
+				continue;
+			}
+
 			boost::tribool result;
-			std::tie(result, std::ignore) = request_parser->parse(
-				*request,
-				buffer_.data(),
-				buffer_.data() + bytes_transferred
+			char const* iter;
+			std::tie(result, iter) = request_parser_.parse(
+				request_,
+				buffer_.get() + buffer_begin_,
+				buffer_.get() + buffer_end_
 			);
+			buffer_begin_ = iter - buffer_.get();
 
-			auto shared_this = shared_from_this();
-			if (result){
-				// handle the request
-				request_handler.handle_request(shared_this, *request, *reply);
-				asio::async_write(
-					socket_,
-					reply->to_buffers(),
-					strand_.wrap(
-						[shared_this, reply](
-							error_code const& err, std::size_t
-						){
-							shared_this->handle_first_write(err);
-						})
-				);
+			if(result){
+				// HTTP/2 by prior knowledge, the session takes over the
+				// rest of the buffer
+				if(options_.http2 && request_count_ == 0
+					&& is_http2_preface(request_)
+				){
+					start_http2();
+					return;
+				}
+
+				if(connection_manager_.add_request()){
+					// handle the request after its body
+					++request_count_;
+					++admitted_requests_;
+					keep_alive = start_body();
+				}else{
+					// too many requests in process, shed the load
+					overloaded_ = true;
+					keep_alive = false;
+					reset_request();
+				}
 			}else if(!result){
 				// request parsing failed
-				*reply = reply::stock_reply(reply::bad_request);
+				replies_.push_back(reply::stock_reply(reply::bad_request));
+				replies_.back().headers.insert(
+					std::make_pair("Connection", "close"));
+				keep_alive = false;
+			}
+		}
+
+		// The parser keeps the state of an incomplete request
+		if(buffer_begin_ == buffer_end_){
+			release_buffer();
+		}
+
+		// Continued by complete_request()
+		if(handling_) return;
+
+		if(replies_.empty() && !overloaded_ && !send_continue_){
+			// wait for the rest
+			do_read();
+		}else{
+			write_replies(keep_alive);
+		}
+	}
+
+	bool connection::start_body(){
+		auto const status = body_parser_.start(request_);
+		if(status != reply::ok) return fail_request(status);
+
+		if(!body_parser_.active()) return finish_request();
+
+		body_callback_ = request_handler_->stream_body(
+			shared_from_this(), request_);
+		if(!body_callback_){
+			if(body_parser_.content_length() > options_.max_body_size){
+				return fail_request(reply::request_entity_too_large);
+			}
+
+			request_.body.reserve(
+				static_cast< std::size_t >(body_parser_.content_length()));
+		}
+
+		if(!check_expectation()) return false;
+
+		set_timeout(options_.body_timeout);
+		return true;
+	}
+
+	bool connection::check_expectation(){
+		// HTTP/1.0 clients don't wait (RFC 7231 5.1.1)
+		bool const http_1_1 = request_.http_version_major > 1
+			|| (request_.http_version_major == 1
+				&& request_.http_version_minor >= 1);
+		if(!http_1_1 || !has_field(request_.headers, "Expect")) return true;
+
+		if(!has_token(request_.headers, "Expect", "100-continue")){
+			return fail_request(reply::expectation_failed);
+		}
+
+		auto rep = reply::stock_reply(reply::expectation_failed);
+		if(!request_handler_->check_continue(
+			shared_from_this(), request_, rep)
+		){
+			return fail_request(std::move(rep));
+		}
+
+		send_continue_ = true;
+		return true;
+	}
+
+	bool connection::handle_body(){
+		boost::tribool result;
+		std::string_view data;
+		char const* iter;
+		std::tie(result, data, iter) = body_parser_.parse(
+			buffer_.get() + buffer_begin_,
+			buffer_.get() + buffer_end_
+		);
+		buffer_begin_ = iter - buffer_.get();
+
+		if(!result) return fail_request(reply::bad_request);
+
+		// The client sends the body without waiting
+		if(!data.empty()) send_continue_ = false;
+
+		if(!body_callback_){
+			// The length of a chunked body is unknown in advance
+			if(request_.body.size() + data.size() > options_.max_body_size){
+				return fail_request(reply::request_entity_too_large);
+			}
+
+			request_.body.append(data);
+		}else if(!body_callback_(data)){
+			// The rest of the body is not read
+			finish_request();
+			return false;
+		}
+
+		if(result){
+			auto& trailers = body_parser_.trailers();
+			request_.headers.insert(trailers.begin(), trailers.end());
+			return finish_request();
+		}
+
+		return true;
+	}
+
+	bool connection::finish_request(){
+		// A pipelined request can't switch the protocol
+		if(options_.http2 && replies_.empty() && !body_parser_.active()
+			&& is_http2_upgrade(request_)
+		){
+			return upgrade_http2();
+		}
+
+		send_continue_ = false;
+		replies_.emplace_back();
+		handling_ = true;
+		completion_ = completion::running;
+
+		// The io_service must run until a deferred completion is handled
+		auto shared_this = shared_from_this();
+		request_handler_->async_handle_request(
+			shared_this, request_, replies_.back(),
+			[shared_this, work = asio::io_service::work(io_service_)]{
+				shared_this->complete_request(work);
+			});
+
+		// The handler completes later, it is responsible for the time
+		auto expected = completion::running;
+		if(completion_.compare_exchange_strong(
+			expected, completion::deferred)
+		){
+			set_timeout(std::chrono::milliseconds(0));
+			return true;
+		}
+
+		return finish_reply();
+	}
+
+	void connection::complete_request(asio::io_service::work const& work){
+		// Within async_handle_request() finish_request() continues
+		auto const state = completion_.exchange(completion::completed);
+		if(state != completion::deferred) return;
+
+		auto shared_this = shared_from_this();
+		post([shared_this, work]{
+			shared_this->handle_buffer(shared_this->finish_reply());
+		});
+	}
+
+	bool connection::finish_reply(){
+		handling_ = false;
+		bool const keep_alive = this->keep_alive(request_, replies_.back());
+
+		body_parser_.reset();
+		body_callback_ = body_fn();
+		reset_request();
+		return keep_alive;
+	}
+
+	void connection::start_http2(){
+		reset_request();
+		auto const session = std::make_shared< http2_session >(
+			shared_from_this(), *request_handler_, connection_manager_,
+			options_);
+		http2_session_ = session;
+		session->start();
+	}
+
+	bool connection::upgrade_http2(){
+		send_continue_ = false;
+
+		auto rep = reply::stock_reply(reply::switching_protocols);
+		rep.headers.insert(std::make_pair("Connection", "Upgrade"));
+		rep.headers.insert(std::make_pair("Upgrade", "h2c"));
+		replies_.push_back(std::move(rep));
+
+		std::string settings;
+		for(auto const& field: request_.headers){
+			if(boost::algorithm::iequals(field.first, "HTTP2-Settings")){
+				settings = field.second;
+			}
+		}
+
+		// The request is answered as stream 1 behind the 101 reply
+		ready_callback_ = [this, req = std::move(request_), settings](
+			connection_ptr const& connection,
+			error_code const& err
+		){
+			if(err) return;
+
+			auto const session = std::make_shared< http2_session >(
+				connection, *request_handler_, connection_manager_, options_);
+			http2_session_ = session;
+			session->start(req, settings);
+		};
+
+		body_parser_.reset();
+		body_callback_ = body_fn();
+		reset_request();
+		return false;
+	}
+
+	bool connection::fail_request(reply::status_type status){
+		return fail_request(reply::stock_reply(status));
+	}
+
+	bool connection::fail_request(http::reply rep){
+		send_continue_ = false;
+		replies_.push_back(std::move(rep));
+		replies_.back().headers.insert(std::make_pair("Connection", "close"));
+
+		body_parser_.reset();
+		body_callback_ = body_fn();
+		reset_request();
+		return false;
+	}
+
+	void connection::write_replies(bool keep_alive){
+		write_buffers_.clear();
+		for(auto const& reply: replies_){
+			reply.to_buffers(write_buffers_);
+		}
+
+		if(overloaded_){
+			write_buffers_.push_back(
+				asio::buffer(connection_manager_.overload_reply()));
+		}
+
+		// The client waits for it before it sends the body
+		if(send_continue_){
+			write_buffers_.push_back(asio::buffer(continue_reply));
+			send_continue_ = false;
+		}
+
+		// A streamed reply is always the last, its first piece is sent
+		// together with the header
+		if(!replies_.empty() && replies_.back().producer
+			&& reply::has_body(replies_.back().status)
+		){
+			chunked_reply_ = has_token(
+				replies_.back().headers, "Transfer-Encoding", "chunked");
+			produce_body();
+		}
+
+		set_timeout(options_.write_timeout);
+
+		auto shared_this = shared_from_this();
+		async(write_memory_,
+			[this](auto handler){
 				asio::async_write(
-					socket_,
-					reply->to_buffers(),
-					strand_.wrap(
-						[shared_this, reply](
-							error_code const& err, std::size_t
-						){
-							shared_this->handle_first_write(err);
-						})
-				);
+					socket_, buffers_ref(write_buffers_), handler);
+			},
+			[shared_this, keep_alive](error_code const& err, std::size_t){
+				shared_this->handle_write(err, keep_alive);
+			});
+	}
+
+	void connection::handle_write(error_code const& err, bool keep_alive){
+		// The next piece is produced when the previous one is written
+		if(!err && streaming_){
+			write_buffers_.clear();
+			produce_body();
+			set_timeout(options_.write_timeout);
+
+			auto shared_this = shared_from_this();
+			async(write_memory_,
+				[this](auto handler){
+					asio::async_write(
+						socket_, buffers_ref(write_buffers_), handler);
+				},
+				[shared_this, keep_alive](error_code const& err, std::size_t){
+					shared_this->handle_write(err, keep_alive);
+				});
+			return;
+		}
+		streaming_ = false;
+
+		// A request, whose body is still received, stays in process
+		std::size_t const pending = body_parser_.active() ? 1 : 0;
+		replies_.clear();
+		connection_manager_.remove_requests(admitted_requests_ - pending);
+		admitted_requests_ = pending;
+
+		// A handler has taken over the connection (e.g. WebSocket)
+		if(ready_callback_){
+			set_timeout(std::chrono::milliseconds(0));
+			ready_callback_(shared_from_this(), err);
+			return;
+		}
+
+		// The server drains, a reply may have been sent before
+		if(connection_manager_.draining()) keep_alive = false;
+
+		if(!err && keep_alive){
+			// Pipelined requests may already be in the buffer
+			if(buffer_begin_ != buffer_end_){
+				set_timeout(body_parser_.active()
+					? options_.body_timeout : options_.header_timeout);
+				handle_buffer();
+			}else if(body_parser_.active()){
+				set_timeout(options_.body_timeout);
+				do_read();
+			}else if(!request_parser_.initial()){
+				// The start of a pipelined request header was received
+				set_timeout(options_.header_timeout);
+				do_read();
 			}else{
-				// wait for the rest
-				socket_.async_read_some(
-					asio::buffer(buffer_),
-					strand_.wrap(
-						[&request_handler, request, request_parser, reply,
-							shared_this](
-							error_code const& err, std::size_t bytes_transferred
-						){
-							shared_this->handle_first_read(
-								request_handler, request, request_parser,
-								reply, err, bytes_transferred);
-						})
-				);
+				idle_ = true;
+				set_timeout(options_.idle_timeout);
+				do_read();
 			}
+		}else if(!err){
+			linger();
 		}
 
-		// If an error occurs then no new asynchronous operations are started.
-		// This means that all shared_ptr references to the connection object
-		// will disappear and the object will be destroyed automatically after
-		// this handler returns. The connection class's destructor closes the
+		// Otherwise no new asynchronous operations are started. This means
+		// that all shared_ptr references to the connection object will
+		// disappear and the object will be destroyed automatically after this
+		// handler returns. The connection class's destructor closes the
 		// socket.
 	}
 
-	void connection::handle_first_write(error_code const& err){
-		if (ready_callback_) ready_callback_(shared_from_this(), err);
+	void connection::linger(){
+		if(options_.linger_timeout.count() == 0) return;
+
+		// The client gets an EOF after the reply
+		error_code ignored_error;
+		socket_.shutdown(stream_protocol::socket::shutdown_send,
+			ignored_error);
+
+		// Unprocessed data is dropped
+		release_buffer();
+		unconsumed_ = false;
+		set_timeout(options_.linger_timeout);
+
+		auto shared_this = shared_from_this();
+		async(read_memory_,
+			[this](auto handler){
+				socket_.async_wait(stream_protocol::socket::wait_read, handler);
+			},
+			[shared_this](error_code const& err){
+				shared_this->handle_linger(err);
+			});
+	}
+
+	void connection::handle_linger(error_code err){
+		if(!err){
+			acquire_buffer();
+			socket_.read_some(asio::buffer(buffer_.get(), buffer_size_), err);
+			release_buffer();
+		}
+
+		// Readiness may be spurious
+		if(!err || err == asio::error::would_block){
+			auto shared_this = shared_from_this();
+			async(read_memory_,
+				[this](auto handler){
+					socket_.async_wait(
+						stream_protocol::socket::wait_read, handler);
+				},
+				[shared_this](error_code const& error){
+					shared_this->handle_linger(error);
+				});
+		}
+
+		// Otherwise the client has closed the connection or the timeout
+		// has expired, the connection is destroyed
+	}
+
+	void connection::produce_body(){
+		body_piece_.clear();
+		streaming_ = replies_.back().producer(body_piece_);
+
+		if(!chunked_reply_){
+			write_buffers_.push_back(asio::buffer(body_piece_));
+			return;
+		}
+
+		// An empty chunk would end the body
+		if(!body_piece_.empty()){
+			std::ostringstream os;
+			os << std::hex << body_piece_.size() << "\r\n";
+			chunk_header_ = os.str();
+
+			write_buffers_.push_back(asio::buffer(chunk_header_));
+			write_buffers_.push_back(asio::buffer(body_piece_));
+			write_buffers_.push_back(asio::buffer(chunk_crlf));
+		}
+
+		if(!streaming_){
+			write_buffers_.push_back(asio::buffer(last_chunk));
+		}
+	}
+
+	bool connection::keep_alive(
+		http::request const& req,
+		http::reply& rep
+	)const{
+		bool keep_alive = options_.keep_alive
+			&& !connection_manager_.draining()
+			&& !body_parser_.active()
+			&& (options_.max_requests_per_connection == 0
+				|| request_count_ < options_.max_requests_per_connection)
+			&& !has_token(rep.headers, "Connection", "close")
+			&& !has_token(rep.headers, "Connection", "upgrade");
 
-		// No new asynchronous operations are started. This means that all
-		// shared_ptr references to the connection object will disappear and
-		// the object will be destroyed automatically after this handler
-		// returns. The connection class's destructor closes the socket.
+		// HTTP/1.1 connections are persistent by default, HTTP/1.0
+		// connections only if the client asks for it
+		bool const http_1_1 = req.http_version_major > 1
+			|| (req.http_version_major == 1 && req.http_version_minor >= 1);
+		if(http_1_1){
+			keep_alive = keep_alive
+				&& !has_token(req.headers, "Connection", "close");
+		}else{
+			keep_alive = keep_alive
+				&& has_token(req.headers, "Connection", "keep-alive");
+		}
+
+		// The client needs the body length to find the end of the reply
+		if(reply::has_body(rep.status)
+			&& !has_field(rep.headers, "Content-Length")
+		){
+			if(rep.producer){
+				// The length of a streamed body is unknown, HTTP/1.0
+				// clients read until the connection is closed
+				if(http_1_1){
+					rep.headers.insert(
+						std::make_pair("Transfer-Encoding", "chunked"));
+				}else{
+					keep_alive = false;
+				}
+			}else if(keep_alive){
+				rep.headers.insert(std::make_pair("Content-Length",
+					std::to_string(rep.content.size())));
+			}
+		}
+
+		if(!has_field(rep.headers, "Connection")){
+			if(!keep_alive){
+				rep.headers.insert(std::make_pair("Connection", "close"));
+			}else if(!http_1_1){
+				rep.headers.insert(std::make_pair("Connection", "keep-alive"));
+			}
+		}
+
+		return keep_alive;
+	}
+
+	void connection::reset_request(){
+		request_ = http::request();
+		request_parser_.reset();
+	}
+
+	void connection::set_timeout(std::chrono::milliseconds timeout){
+		if(timeout.count() == 0){
+			deadline_ = timer_wheel::clock::time_point::max();
+			timer_wheel_.cancel(timeout_);
+			return;
+		}
+
+		deadline_ = timer_wheel::clock::now() + timeout;
+		timer_wheel_.schedule(timeout_, timeout);
+	}
+
+	void connection::handle_timeout(){
+		// The timeout was changed after it expired
+		if(timer_wheel::clock::now() < deadline_) return;
+
+		close();
+	}
+
+	void connection::resume_timeout(){
+		if(takeover_deadline_ == timer_wheel::clock::time_point::max()){
+			set_timeout(std::chrono::milliseconds(0));
+			return;
+		}
+
+		// An expired deadline closes at the next tick
+		auto const rest = std::chrono::ceil< std::chrono::milliseconds >(
+			takeover_deadline_ - timer_wheel::clock::now());
+		set_timeout(std::max(rest, std::chrono::milliseconds(1)));
+	}
+
+	void connection::timeout(std::chrono::milliseconds timeout){
+		takeover_deadline_ = timeout.count() == 0
+			? timer_wheel::clock::time_point::max()
+			: timer_wheel::clock::now() + timeout;
+
+		// The write timeout applies until the queue is written
+		if(write_queue_.empty()) resume_timeout();
+	}
+
+	void connection::shutdown(bool force){
+		auto shared_this = shared_from_this();
+		post([shared_this, force]{
+			if(force || shared_this->idle_){
+				shared_this->close();
+				return;
+			}
+
+			// HTTP/2 announces the shutdown to the client
+			if(auto const session = shared_this->http2_session_.lock()){
+				session->shutdown();
+			}
+		});
+	}
+
+	void connection::close(){
+		error_code ignored_error;
+		socket_.shutdown(stream_protocol::socket::shutdown_both, ignored_error);
+		socket_.close(ignored_error);
+	}
+
+	void connection::reset(){
+		close();
+		set_timeout(std::chrono::milliseconds(0));
+		timeout_.callback(std::function< void() >());
+		idle_ = false;
+
+		if(request_handler_){
+			connection_manager_.remove_requests(admitted_requests_);
+			connection_manager_.remove_connection(*this);
+		}
+
+		request_handler_ = nullptr;
+		release_buffer();
+		read_size_ = options_.read_buffer_size;
+		unconsumed_ = false;
+		delivering_ = false;
+		next_read_ = callback_read_view_fn();
+		reset_request();
+		body_parser_.reset();
+		body_callback_ = body_fn();
+		handling_ = false;
+		completion_ = completion::completed;
+		send_continue_ = false;
+		replies_.clear();
+		write_buffers_.clear();
+		streaming_ = false;
+		chunked_reply_ = false;
+		body_piece_.clear();
+		request_count_ = 0;
+		admitted_requests_ = 0;
+		overloaded_ = false;
+		write_queue_.clear();
+		queued_bytes_ = 0;
+		writing_ = 0;
+		corked_ = false;
+		quick_ack_ = false;
+		takeover_deadline_ = timer_wheel::clock::time_point::max();
+		ready_callback_ = callback_write_fn();
+		http2_session_.reset();
 	}
 
 	void connection::ready_callback(callback_write_fn callback){
 		ready_callback_ = callback;
 	}
 
-	error_code connection::write(
-		std::shared_ptr< std::string const > const& data
+	bool connection::write(
+		std::shared_ptr< std::string const > data,
+		callback_write_fn callback
 	){
-		error_code err;
-		asio::write(socket_, asio::buffer(*data), err);
-		return err;
+		auto shared_this = shared_from_this();
+		auto const size = data->size();
+		auto const queued = queued_bytes_ += size;
+
+		if(options_.write_queue_limit != 0
+			&& queued > options_.write_queue_limit
+		){
+			queued_bytes_ -= size;
+			if(callback){
+				post([shared_this, callback = std::move(callback)]{
+					callback(shared_this, asio::error::no_buffer_space);
+				});
+			}
+			return false;
+		}
+
+		// The queue is only accessed within the strand
+		post([shared_this, data = std::move(data),
+			callback = std::move(callback)]()mutable{
+				shared_this->write_queue_.push_back(
+					queued_write{std::move(data), std::move(callback)});
+				if(shared_this->writing_ == 0) shared_this->do_write();
+			});
+
+		return options_.write_high_water_mark == 0
+			|| queued <= options_.write_high_water_mark;
+	}
+
+	void connection::do_write(){
+		// Gather as many queued writes as allowed into one writev
+		write_buffers_.clear();
+		std::size_t bytes = 0;
+		for(auto const& entry: write_queue_){
+			if(!write_buffers_.empty() && (
+				write_buffers_.size() >= options_.write_gather_buffers
+				|| bytes + entry.data->size() > options_.write_gather_bytes
+			)) break;
+
+			write_buffers_.push_back(asio::buffer(*entry.data));
+			bytes += entry.data->size();
+		}
+		writing_ = write_buffers_.size();
+
+#ifdef TCP_CORK
+		// Let the kernel fill complete segments while more data follows
+		if(options_.cork_writes && !corked_
+			&& writing_ < write_queue_.size()
+		){
+			error_code ignored_error;
+			socket_.set_option(tcp_cork(true), ignored_error);
+			corked_ = true;
+		}
+#endif
+
+		set_timeout(options_.write_timeout);
+
+		auto shared_this = shared_from_this();
+		async(write_memory_,
+			[this](auto handler){
+				asio::async_write(
+					socket_, buffers_ref(write_buffers_), handler);
+			},
+			[shared_this](error_code const& err, std::size_t){
+				shared_this->handle_queued_write(err);
+			});
+	}
+
+	void connection::handle_queued_write(error_code const& err){
+		if(err){
+			// The connection is unusable, fail all queued writes
+			close();
+			set_timeout(std::chrono::milliseconds(0));
+
+			auto queue = std::move(write_queue_);
+			write_queue_.clear();
+			writing_ = 0;
+			for(auto& entry: queue){
+				queued_bytes_ -= entry.data->size();
+				if(entry.callback) entry.callback(shared_from_this(), err);
+			}
+			return;
+		}
+
+		// Callbacks can only queue further writes by posting them
+		for(; writing_ > 0; --writing_){
+			auto entry = std::move(write_queue_.front());
+			write_queue_.pop_front();
+			queued_bytes_ -= entry.data->size();
+			if(entry.callback) entry.callback(shared_from_this(), err);
+		}
+
+		if(!write_queue_.empty()){
+			do_write();
+		}else{
+			resume_timeout();
+
+#ifdef TCP_CORK
+			// Flush the last partial segment
+			if(corked_){
+				error_code ignored_error;
+				socket_.set_option(tcp_cork(false), ignored_error);
+				corked_ = false;
+			}
+#endif
+		}
 	}
 
 	void connection::read(callback_read_fn callback){
+		read_view([callback = std::move(callback)](
+			connection_ptr const& connection,
+			std::string_view data,
+			error_code const& err
+		){
+			callback(connection, std::string(data), err);
+			return data.size();
+		});
+	}
+
+	void connection::read_view(callback_read_view_fn callback){
+		// Called by a callback, the buffer is updated after it returns
+		if(delivering_){
+			next_read_ = std::move(callback);
+			return;
+		}
+
 		auto shared_this = shared_from_this();
-		socket_.async_read_some(
-			asio::buffer(buffer_),
-			strand_.wrap(
-				[shared_this, callback](
-					error_code const& err, std::size_t bytes_transferred
-				){
-					std::string data(
-						shared_this->buffer_.data(),
-						shared_this->buffer_.data() + bytes_transferred);
-					callback(shared_this, data, err);
-				})
-		);
+
+		// Data that was received behind the last request belongs to the
+		// handler that has taken over the connection
+		if(buffer_begin_ != buffer_end_ && !unconsumed_){
+			post([shared_this, callback = std::move(callback)]{
+				shared_this->deliver(callback, error_code());
+			});
+			return;
+		}
+
+		async(read_memory_,
+			[this](auto handler){
+				socket_.async_wait(stream_protocol::socket::wait_read, handler);
+			},
+			[shared_this, callback = std::move(callback)](error_code err){
+				if(!err) shared_this->receive(err);
+
+				if(err == asio::error::would_block){
+					shared_this->read_view(callback);
+					return;
+				}
+
+				shared_this->deliver(callback, err);
+			});
+	}
+
+	void connection::deliver(
+		callback_read_view_fn const& callback,
+		error_code err
+	){
+		std::string_view data;
+		if(!err){
+			data = std::string_view(buffer_.get() + buffer_begin_,
+				buffer_end_ - buffer_begin_);
+		}else{
+			release_buffer();
+			unconsumed_ = false;
+		}
+
+		delivering_ = true;
+		auto const consumed = callback(shared_from_this(), data, err);
+		delivering_ = false;
+
+		buffer_begin_ += std::min(consumed, data.size());
+		unconsumed_ = buffer_begin_ != buffer_end_;
+		if(!unconsumed_) release_buffer();
+
+		if(next_read_){
+			auto next_read = std::move(next_read_);
+			next_read_ = callback_read_view_fn();
+			read_view(std::move(next_read));
+		}
+	}
+
+	std::size_t connection::receive(error_code& err){
+		acquire_buffer();
+
+		// Keep the unprocessed data in front of the new data
+		auto const unprocessed = buffer_end_ - buffer_begin_;
+		auto const max_size = std::max(
+			options_.max_read_buffer_size, options_.read_buffer_size);
+		if(unprocessed == buffer_size_){
+			if(buffer_size_ >= max_size){
+				err = asio::error::no_buffer_space;
+				return 0;
+			}
+
+			auto const size = std::min(buffer_size_ * 2, max_size);
+			std::unique_ptr< char[] > buffer(new char[size]);
+			std::copy(buffer_.get(), buffer_.get() + unprocessed,
+				buffer.get());
+			buffer_ = std::move(buffer);
+			buffer_size_ = size;
+		}else if(buffer_begin_ != 0){
+			std::copy(buffer_.get() + buffer_begin_,
+				buffer_.get() + buffer_end_, buffer_.get());
+		}
+		buffer_begin_ = 0;
+		buffer_end_ = unprocessed;
+
+		auto const space = buffer_size_ - buffer_end_;
+		auto const bytes_transferred = socket_.read_some(
+			asio::buffer(buffer_.get() + buffer_end_, space), err);
+		if(bytes_transferred == 0){
+			if(buffer_end_ == 0) release_buffer();
+			return 0;
+		}
+		buffer_end_ += bytes_transferred;
+
+#ifdef TCP_QUICKACK
+		// Unix domain sockets don't support it
+		if(quick_ack_){
+			error_code quick_ack_error;
+			socket_.set_option(quick_ack(true), quick_ack_error);
+			if(quick_ack_error) quick_ack_ = false;
+		}
+#endif
+
+		// Grow while the reads fill the buffer, shrink if they don't
+		if(bytes_transferred == space){
+			read_size_ = std::min(read_size_ * 2, max_size);
+		}else if(bytes_transferred <= space / 4){
+			read_size_ = std::max(read_size_ / 2, options_.read_buffer_size);
+		}
+
+		return bytes_transferred;
+	}
+
+	void connection::acquire_buffer(){
+		if(buffer_) return;
+
+		auto& pool = thread_read_buffer_pool();
+		if(read_size_ == pool.size && !pool.buffers.empty()){
+			buffer_ = std::move(pool.buffers.back());
+			pool.buffers.pop_back();
+		}else{
+			buffer_.reset(new char[read_size_]);
+		}
+		buffer_size_ = read_size_;
+	}
+
+	void connection::release_buffer(){
+		buffer_begin_ = 0;
+		buffer_end_ = 0;
+		if(!buffer_) return;
+
+		// Only buffers of the initial size are kept
+		auto& pool = thread_read_buffer_pool();
+		if(buffer_size_ == options_.read_buffer_size){
+			if(pool.size != buffer_size_ && pool.buffers.empty()){
+				pool.size = buffer_size_;
+			}
+
+			if(pool.size == buffer_size_
+				&& pool.buffers.size() < options_.read_buffer_pool_size
+			){
+				pool.buffers.push_back(std::move(buffer_));
+			}
+		}
+
+		buffer_.reset();
+		buffer_size_ = 0;
 	}
 
 
@@ -0,0 +1,139 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#include <http/server_connection_manager.hpp>
+
+#include <http/reply.hpp>
+#include <http/server_connection.hpp>
+
+
+namespace http::server{
+
+
+	namespace{
+
+
+		/// \brief Serialize the 503 reply once
+		std::string make_overload_reply(options const& options){
+			auto reply = reply::stock_reply(reply::service_unavailable);
+			reply.headers.insert(std::make_pair("Retry-After",
+				std::to_string(options.retry_after.count())));
+			reply.headers.insert(std::make_pair("Connection", "close"));
+
+			auto const buffers = reply.to_buffers();
+			std::string result(asio::buffer_size(buffers), '\0');
+			asio::buffer_copy(asio::buffer(&result[0], result.size()), buffers);
+			return result;
+		}
+
+		/// \brief Increment the counter if it is below the limit,
+		///        0 means unlimited
+		bool increment(std::atomic< std::size_t >& counter, std::size_t limit){
+			if(limit == 0){
+				++counter;
+				return true;
+			}
+
+			auto value = counter.load();
+			do{
+				if(value >= limit) return false;
+			}while(!counter.compare_exchange_weak(value, value + 1));
+
+			return true;
+		}
+
+
+	}
+
+
+	connection_manager::connection_manager(options const& options):
+		options_(options),
+		overload_reply_(make_overload_reply(options))
+		{}
+
+	bool connection_manager::add_connection(){
+		return increment(connections_, options_.max_connections);
+	}
+
+	void connection_manager::register_connection(connection& connection){
+		std::lock_guard< std::mutex > lock(mutex_);
+		connection_list_.insert(&connection);
+	}
+
+	void connection_manager::remove_connection(connection& connection){
+		{
+			std::lock_guard< std::mutex > lock(mutex_);
+			connection_list_.erase(&connection);
+			--connections_;
+		}
+
+		if(draining_) closed_.notify_all();
+
+		if(paused_.exchange(false) && resume_callback_){
+			resume_callback_();
+		}
+	}
+
+	bool connection_manager::add_request(){
+		return increment(requests_, options_.max_inflight_requests);
+	}
+
+	void connection_manager::remove_requests(std::size_t count){
+		requests_ -= count;
+	}
+
+	bool connection_manager::connections_exhausted()const{
+		return options_.max_connections != 0
+			&& connections_ >= options_.max_connections;
+	}
+
+	void connection_manager::resume_callback(std::function< void() > callback){
+		resume_callback_ = std::move(callback);
+	}
+
+	void connection_manager::pause(){
+		paused_ = true;
+
+		// A connection may have been closed in the meantime
+		if(!connections_exhausted() && paused_.exchange(false)
+			&& resume_callback_
+		){
+			resume_callback_();
+		}
+	}
+
+	void connection_manager::start_drain(){
+		draining_ = true;
+	}
+
+	std::vector< std::shared_ptr< connection > >
+	connection_manager::registered_connections(){
+		std::vector< std::shared_ptr< connection > > result;
+
+		std::lock_guard< std::mutex > lock(mutex_);
+		result.reserve(connection_list_.size());
+		for(auto connection: connection_list_){
+			// A connection without owner is being closed right now
+			if(auto shared = connection->weak_from_this().lock()){
+				result.push_back(std::move(shared));
+			}
+		}
+
+		return result;
+	}
+
+	bool connection_manager::wait_closed(
+		std::chrono::steady_clock::time_point deadline
+	){
+		std::unique_lock< std::mutex > lock(mutex_);
+		return closed_.wait_until(lock, deadline,
+			[this]{ return connections_ == 0; });
+	}
+
+
+}
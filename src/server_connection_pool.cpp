@@ -0,0 +1,98 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#include <http/server_connection_pool.hpp>
+
+
+namespace http::server{
+
+
+	connection_pool::connection_pool(
+		asio::io_service& io_service,
+		options const& options,
+		http::server::timer_wheel& timer_wheel,
+		http::server::connection_manager& connection_manager
+	):
+		io_service_(io_service),
+		options_(options),
+		timer_wheel_(timer_wheel),
+		connection_manager_(connection_manager)
+	{
+		idle_.reserve(options_.connection_pool_size);
+		for(std::size_t i = 0; i < options_.connection_pool_preallocate
+			&& i < options_.connection_pool_size; ++i
+		){
+			idle_.emplace_back(new connection(
+				io_service_, options_, timer_wheel_, connection_manager_));
+			++created_;
+		}
+	}
+
+	connection_ptr connection_pool::get(){
+		std::unique_ptr< connection > connection;
+
+		{
+			std::lock_guard< std::mutex > lock(mutex_);
+			if(!idle_.empty()){
+				connection = std::move(idle_.back());
+				idle_.pop_back();
+			}
+		}
+
+		if(connection){
+			++reused_;
+		}else{
+			connection.reset(new http::server::connection(
+				io_service_, options_, timer_wheel_, connection_manager_));
+			++created_;
+		}
+
+		return connection_ptr(connection.release(),
+			deleter{shared_from_this()});
+	}
+
+	connection_pool::statistics connection_pool::get_statistics()const{
+		statistics result;
+		result.created = created_;
+		result.reused = reused_;
+		result.recycled = recycled_;
+		result.discarded = discarded_;
+
+		std::lock_guard< std::mutex > lock(mutex_);
+		result.idle = idle_.size();
+		return result;
+	}
+
+	void connection_pool::deleter::operator()(connection* connection)const{
+		if(auto pool = this->pool.lock()){
+			pool->recycle(connection);
+		}else{
+			delete connection;
+		}
+	}
+
+	void connection_pool::recycle(connection* connection){
+		std::unique_ptr< http::server::connection > owner(connection);
+		owner->reset();
+
+		{
+			std::lock_guard< std::mutex > lock(mutex_);
+			if(idle_.size() < options_.connection_pool_size){
+				idle_.push_back(std::move(owner));
+			}
+		}
+
+		if(owner){
+			++discarded_;
+		}else{
+			++recycled_;
+		}
+	}
+
+
+}
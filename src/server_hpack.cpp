@@ -0,0 +1,473 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#include <http/server_hpack.hpp>
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+
+namespace http::server{
+
+
+	namespace{
+
+
+		/// \brief Entries of the static table (RFC 7541 Appendix A)
+		struct static_entry{
+			char const* name;
+			char const* value;
+		};
+
+		/// \brief The static table, index 1 is the first entry
+		static_entry const static_table[] = {
+			{":authority", ""},
+			{":method", "GET"},
+			{":method", "POST"},
+			{":path", "/"},
+			{":path", "/index.html"},
+			{":scheme", "http"},
+			{":scheme", "https"},
+			{":status", "200"},
+			{":status", "204"},
+			{":status", "206"},
+			{":status", "304"},
+			{":status", "400"},
+			{":status", "404"},
+			{":status", "500"},
+			{"accept-charset", ""},
+			{"accept-encoding", "gzip, deflate"},
+			{"accept-language", ""},
+			{"accept-ranges", ""},
+			{"accept", ""},
+			{"access-control-allow-origin", ""},
+			{"age", ""},
+			{"allow", ""},
+			{"authorization", ""},
+			{"cache-control", ""},
+			{"content-disposition", ""},
+			{"content-encoding", ""},
+			{"content-language", ""},
+			{"content-length", ""},
+			{"content-location", ""},
+			{"content-range", ""},
+			{"content-type", ""},
+			{"cookie", ""},
+			{"date", ""},
+			{"etag", ""},
+			{"expect", ""},
+			{"expires", ""},
+			{"from", ""},
+			{"host", ""},
+			{"if-match", ""},
+			{"if-modified-since", ""},
+			{"if-none-match", ""},
+			{"if-range", ""},
+			{"if-unmodified-since", ""},
+			{"last-modified", ""},
+			{"link", ""},
+			{"location", ""},
+			{"max-forwards", ""},
+			{"proxy-authenticate", ""},
+			{"proxy-authorization", ""},
+			{"range", ""},
+			{"referer", ""},
+			{"refresh", ""},
+			{"retry-after", ""},
+			{"server", ""},
+			{"set-cookie", ""},
+			{"strict-transport-security", ""},
+			{"transfer-encoding", ""},
+			{"user-agent", ""},
+			{"vary", ""},
+			{"via", ""},
+			{"www-authenticate", ""}
+		};
+
+		/// \brief Count of entries of the static table
+		constexpr std::size_t static_table_size =
+			sizeof(static_table) / sizeof(static_table[0]);
+
+		/// \brief Every entry of the dynamic table counts its name, its
+		///        value and this overhead (RFC 7541 4.1)
+		constexpr std::size_t entry_overhead = 32;
+
+		/// \brief A code of the Huffman code (RFC 7541 Appendix B)
+		struct huffman_code{
+			std::uint32_t bits;
+			std::uint8_t length;
+		};
+
+		/// \brief The Huffman code of every byte and of EOS (256)
+		huffman_code const huffman_codes[257] = {
+			{0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+			{0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+			{0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+			{0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+			{0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+			{0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+			{0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+			{0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+			{0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+			{0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+			{0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+			{0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+			{0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6},
+			{0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+			{0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+			{0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+			{0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7},
+			{0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+			{0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7},
+			{0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+			{0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+			{0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+			{0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13},
+			{0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+			{0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5},
+			{0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+			{0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+			{0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+			{0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5},
+			{0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+			{0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15},
+			{0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+			{0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+			{0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+			{0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23},
+			{0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+			{0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+			{0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+			{0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+			{0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+			{0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22},
+			{0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+			{0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24},
+			{0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+			{0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+			{0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+			{0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22},
+			{0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+			{0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19},
+			{0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+			{0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+			{0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+			{0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27},
+			{0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+			{0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26},
+			{0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+			{0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+			{0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+			{0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25},
+			{0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+			{0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26},
+			{0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+			{0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+			{0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+			{0x3fffffff, 30},
+		};
+
+		/// \brief Symbol of EOS
+		constexpr int huffman_eos = 256;
+
+		/// \brief Binary tree to decode the Huffman code
+		class huffman_tree{
+		public:
+			/// \brief A node is a leaf if symbol is not negative
+			struct node{
+				std::int16_t child[2] = {-1, -1};
+				std::int16_t symbol = -1;
+			};
+
+			huffman_tree(){
+				nodes_.emplace_back();
+				for(int symbol = 0; symbol <= huffman_eos; ++symbol){
+					auto const& code = huffman_codes[symbol];
+					std::size_t index = 0;
+					for(int i = code.length - 1; i >= 0; --i){
+						auto const bit = (code.bits >> i) & 1;
+						if(nodes_[index].child[bit] < 0){
+							nodes_[index].child[bit] =
+								static_cast< std::int16_t >(nodes_.size());
+							nodes_.emplace_back();
+						}
+						index = nodes_[index].child[bit];
+					}
+					nodes_[index].symbol = static_cast< std::int16_t >(symbol);
+				}
+			}
+
+			node const& operator[](std::size_t index)const{
+				return nodes_[index];
+			}
+
+		private:
+			std::vector< node > nodes_;
+		};
+
+		/// \brief Decode a Huffman encoded string, false if it is invalid
+		bool huffman_decode(std::string_view data, std::string& out){
+			static huffman_tree const tree;
+
+			std::size_t index = 0;
+			std::size_t pending_bits = 0;
+			bool padding = true;
+			for(unsigned char c: data){
+				for(int i = 7; i >= 0; --i){
+					auto const bit = (c >> i) & 1;
+					index = tree[index].child[bit];
+					++pending_bits;
+					padding = padding && bit;
+
+					auto const symbol = tree[index].symbol;
+					if(symbol < 0) continue;
+					if(symbol == huffman_eos) return false;
+
+					out.push_back(static_cast< char >(symbol));
+					index = 0;
+					pending_bits = 0;
+					padding = true;
+				}
+			}
+
+			// The padding is shorter than a byte and a prefix of EOS
+			return pending_bits < 8 && padding;
+		}
+
+		/// \brief Decode an integer with a prefix of prefix_bits bits
+		/// (RFC 7541 5.1), false if it is invalid
+		bool decode_integer(
+			char const*& pos,
+			char const* end,
+			int prefix_bits,
+			std::size_t& value
+		){
+			if(pos == end) return false;
+
+			std::size_t const max_prefix = (1u << prefix_bits) - 1;
+			value = static_cast< unsigned char >(*pos++) & max_prefix;
+			if(value < max_prefix) return true;
+
+			// Values are limited, larger ones are an attack
+			for(int shift = 0; shift < 28; shift += 7){
+				if(pos == end) return false;
+
+				auto const byte = static_cast< unsigned char >(*pos++);
+				value += static_cast< std::size_t >(byte & 0x7f) << shift;
+				if((byte & 0x80) == 0) return true;
+			}
+
+			return false;
+		}
+
+		/// \brief Decode a string literal (RFC 7541 5.2), false if it is
+		/// invalid
+		bool decode_string(
+			char const*& pos,
+			char const* end,
+			std::string& out
+		){
+			if(pos == end) return false;
+
+			bool const huffman = (*pos & 0x80) != 0;
+			std::size_t length;
+			if(!decode_integer(pos, end, 7, length)) return false;
+			if(length > static_cast< std::size_t >(end - pos)) return false;
+
+			std::string_view const data(pos, length);
+			pos += length;
+
+			out.clear();
+			if(!huffman){
+				out.assign(data);
+				return true;
+			}
+
+			return huffman_decode(data, out);
+		}
+
+		/// \brief Append an integer with a prefix of prefix_bits bits to
+		///        out, flags are the other bits of the first byte
+		void encode_integer(
+			std::string& out,
+			std::uint8_t flags,
+			int prefix_bits,
+			std::size_t value
+		){
+			std::size_t const max_prefix = (1u << prefix_bits) - 1;
+			if(value < max_prefix){
+				out.push_back(static_cast< char >(flags | value));
+				return;
+			}
+
+			out.push_back(static_cast< char >(flags | max_prefix));
+			value -= max_prefix;
+			while(value >= 0x80){
+				out.push_back(static_cast< char >((value & 0x7f) | 0x80));
+				value >>= 7;
+			}
+			out.push_back(static_cast< char >(value));
+		}
+
+		/// \brief Append a string literal without Huffman coding to out
+		void encode_string(std::string& out, std::string_view data){
+			encode_integer(out, 0, 7, data.size());
+			out.append(data);
+		}
+
+
+	}
+
+
+	hpack_decoder::hpack_decoder(
+		std::size_t max_table_size,
+		std::size_t max_list_size
+	):
+		max_table_size_(max_table_size),
+		max_list_size_(max_list_size),
+		table_limit_(max_table_size)
+		{}
+
+	hpack_decoder::result hpack_decoder::decode(
+		std::string_view block,
+		hpack_field_list& fields
+	){
+		fields.clear();
+
+		char const* pos = block.data();
+		char const* const end = pos + block.size();
+		std::size_t list_size = 0;
+		bool oversized = false;
+		bool first = true;
+		while(pos != end){
+			auto const byte = static_cast< unsigned char >(*pos);
+
+			// Table size updates must precede the fields
+			if((byte & 0xe0) == 0x20){
+				std::size_t size;
+				if(!first || !decode_integer(pos, end, 5, size)
+					|| size > max_table_size_
+				){
+					return invalid;
+				}
+
+				table_limit_ = size;
+				evict(table_limit_);
+				continue;
+			}
+			first = false;
+
+			hpack_field decoded;
+			if(byte & 0x80){
+				// Indexed field
+				std::size_t index;
+				if(!decode_integer(pos, end, 7, index)) return invalid;
+
+				if(!field(index, decoded)) return invalid;
+			}else{
+				// Literal with incremental indexing, without indexing or
+				// never indexed
+				bool const indexing = (byte & 0xc0) == 0x40;
+				std::size_t index;
+				if(!decode_integer(pos, end, indexing ? 6 : 4, index)){
+					return invalid;
+				}
+
+				if(index == 0){
+					if(!decode_string(pos, end, decoded.first)) return invalid;
+				}else{
+					if(!field(index, decoded)) return invalid;
+				}
+
+				if(!decode_string(pos, end, decoded.second)) return invalid;
+
+				if(indexing) insert(decoded);
+			}
+
+			// The table is kept up to date, but the fields are dropped
+			list_size += decoded.first.size() + decoded.second.size()
+				+ entry_overhead;
+			if(list_size > max_list_size_){
+				oversized = true;
+				fields.clear();
+			}
+
+			if(!oversized) fields.push_back(std::move(decoded));
+		}
+
+		return oversized ? too_large : ok;
+	}
+
+	bool hpack_decoder::field(std::size_t index, hpack_field& entry)const{
+		if(index == 0) return false;
+
+		if(index <= static_table_size){
+			auto const& fixed = static_table[index - 1];
+			entry.first = fixed.name;
+			entry.second = fixed.value;
+			return true;
+		}
+
+		index -= static_table_size + 1;
+		if(index >= table_.size()) return false;
+
+		entry = table_[index];
+		return true;
+	}
+
+	void hpack_decoder::insert(hpack_field const& field){
+		auto const size = field.first.size() + field.second.size()
+			+ entry_overhead;
+
+		// A field larger than the table empties it (RFC 7541 4.4)
+		if(size > table_limit_){
+			evict(0);
+			return;
+		}
+
+		evict(table_limit_ - size);
+		table_.push_front(field);
+		table_size_ += size;
+	}
+
+	void hpack_decoder::evict(std::size_t size){
+		while(table_size_ > size){
+			auto const& field = table_.back();
+			table_size_ -= field.first.size() + field.second.size()
+				+ entry_overhead;
+			table_.pop_back();
+		}
+	}
+
+	void hpack_encode(
+		std::string& block,
+		std::string_view name,
+		std::string_view value
+	){
+		std::size_t name_index = 0;
+		for(std::size_t i = 0; i < static_table_size; ++i){
+			if(name != static_table[i].name) continue;
+
+			// Indexed field
+			if(value == static_table[i].value){
+				encode_integer(block, 0x80, 7, i + 1);
+				return;
+			}
+
+			if(name_index == 0) name_index = i + 1;
+		}
+
+		// Literal without indexing
+		encode_integer(block, 0x00, 4, name_index);
+		if(name_index == 0) encode_string(block, name);
+		encode_string(block, value);
+	}
+
+
+}
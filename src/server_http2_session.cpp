@@ -0,0 +1,1217 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#include <http/server_http2_session.hpp>
+
+#include <http/server_request_parser.hpp>
+
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+
+namespace http::server{
+
+
+	namespace{
+
+
+		/// \brief Frame types (RFC 7540 6)
+		enum frame_type: std::uint8_t{
+			data_frame = 0x0,
+			headers_frame = 0x1,
+			priority_frame = 0x2,
+			rst_stream_frame = 0x3,
+			settings_frame = 0x4,
+			push_promise_frame = 0x5,
+			ping_frame = 0x6,
+			goaway_frame = 0x7,
+			window_update_frame = 0x8,
+			continuation_frame = 0x9
+		};
+
+		/// \brief Frame flags
+		constexpr std::uint8_t end_stream_flag = 0x1;
+		constexpr std::uint8_t ack_flag = 0x1;
+		constexpr std::uint8_t end_headers_flag = 0x4;
+		constexpr std::uint8_t padded_flag = 0x8;
+		constexpr std::uint8_t priority_flag = 0x20;
+
+		/// \brief Settings (RFC 7540 6.5.2)
+		enum setting: std::uint16_t{
+			settings_header_table_size = 0x1,
+			settings_enable_push = 0x2,
+			settings_max_concurrent_streams = 0x3,
+			settings_initial_window_size = 0x4,
+			settings_max_frame_size = 0x5,
+			settings_max_header_list_size = 0x6
+		};
+
+		/// \brief Size of a frame header
+		constexpr std::size_t frame_header_size = 9;
+
+		/// \brief Maximal frame payload the server accepts, the default of
+		///        SETTINGS_MAX_FRAME_SIZE
+		constexpr std::size_t max_frame_payload = 16384;
+
+		/// \brief Maximal size of a flow control window
+		constexpr std::int64_t max_window = 0x7fffffff;
+
+		/// \brief Size of the HPACK dynamic table, the default of
+		///        SETTINGS_HEADER_TABLE_SIZE
+		constexpr std::size_t hpack_table_size = 4096;
+
+		/// \brief The client preface (RFC 7540 3.5)
+		constexpr std::string_view client_preface =
+			"PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+		/// \brief The part of the client preface behind the request line
+		///        and the empty line read by the HTTP/1 parser
+		constexpr std::string_view client_preface_rest = "SM\r\n\r\n";
+
+
+		std::uint32_t read_u16(char const* data){
+			auto const bytes = reinterpret_cast< unsigned char const* >(data);
+			return (std::uint32_t(bytes[0]) << 8) | bytes[1];
+		}
+
+		std::uint32_t read_u24(char const* data){
+			auto const bytes = reinterpret_cast< unsigned char const* >(data);
+			return (std::uint32_t(bytes[0]) << 16)
+				| (std::uint32_t(bytes[1]) << 8) | bytes[2];
+		}
+
+		std::uint32_t read_u32(char const* data){
+			auto const bytes = reinterpret_cast< unsigned char const* >(data);
+			return (std::uint32_t(bytes[0]) << 24)
+				| (std::uint32_t(bytes[1]) << 16)
+				| (std::uint32_t(bytes[2]) << 8) | bytes[3];
+		}
+
+		void append_u16(std::string& out, std::uint32_t value){
+			out.push_back(static_cast< char >(value >> 8));
+			out.push_back(static_cast< char >(value));
+		}
+
+		void append_u24(std::string& out, std::uint32_t value){
+			out.push_back(static_cast< char >(value >> 16));
+			append_u16(out, value);
+		}
+
+		void append_u32(std::string& out, std::uint32_t value){
+			append_u16(out, value >> 16);
+			append_u16(out, value);
+		}
+
+		/// \brief Remove the padding of a DATA or HEADERS frame, false if
+		///        it is invalid
+		bool strip_padding(std::uint8_t flags, std::string_view& data){
+			if((flags & padded_flag) == 0) return true;
+			if(data.empty()) return false;
+
+			std::size_t const padding = static_cast< unsigned char >(data[0]);
+			data.remove_prefix(1);
+			if(padding > data.size()) return false;
+
+			data.remove_suffix(padding);
+			return true;
+		}
+
+		/// \brief Size of the receive windows of the server
+		std::int64_t receive_window_size(options const& options){
+			return std::clamp< std::int64_t >(
+				options.http2_initial_window_size, 65535, max_window);
+		}
+
+		/// \brief Decode the base64url value of HTTP2-Settings, false if it
+		///        is invalid
+		bool base64url_decode(std::string_view in, std::string& out){
+			std::uint32_t value = 0;
+			int bits = 0;
+			for(char c: in){
+				std::uint32_t digit;
+				if(c >= 'A' && c <= 'Z'){
+					digit = c - 'A';
+				}else if(c >= 'a' && c <= 'z'){
+					digit = c - 'a' + 26;
+				}else if(c >= '0' && c <= '9'){
+					digit = c - '0' + 52;
+				}else if(c == '-' || c == '+'){
+					digit = 62;
+				}else if(c == '_' || c == '/'){
+					digit = 63;
+				}else if(c == '='){
+					break;
+				}else{
+					return false;
+				}
+
+				value = (value << 6) | digit;
+				bits += 6;
+				if(bits >= 8){
+					bits -= 8;
+					out.push_back(static_cast< char >(value >> bits));
+				}
+			}
+
+			return true;
+		}
+
+		/// \brief HTTP/1 spelling of a lower case field name
+		std::string canonical_name(std::string name){
+			bool upper = true;
+			for(auto& c: name){
+				if(upper && c >= 'a' && c <= 'z') c = c - 'a' + 'A';
+				upper = c == '-';
+			}
+			return name;
+		}
+
+		/// \brief Fields of HTTP/1 connections, that HTTP/2 doesn't use
+		///        (RFC 7540 8.1.2.2)
+		bool is_connection_field(std::string const& name){
+			for(char const* field: {"connection", "keep-alive",
+				"proxy-connection", "transfer-encoding", "upgrade"}
+			){
+				if(name == field) return true;
+			}
+
+			return false;
+		}
+
+		/// \brief Value of the Content-Length field, 0 if there is none
+		std::uint64_t content_length(http::header const& headers){
+			auto const iter = headers.find("Content-Length");
+			if(iter == headers.end()) return 0;
+
+			try{
+				return std::stoull(iter->second);
+			}catch(std::exception const&){
+				return 0;
+			}
+		}
+
+
+	}
+
+
+	http2_session::http2_session(
+		connection_ptr connection,
+		request_handler& handler,
+		http::server::connection_manager& connection_manager,
+		options const& options
+	):
+		connection_(std::move(connection)),
+		request_handler_(handler),
+		connection_manager_(connection_manager),
+		options_(options),
+		decoder_(hpack_table_size, options.http2_max_header_list_size)
+		{}
+
+	void http2_session::start(){
+		connection_->timeout(options_.header_timeout);
+		preface_ = client_preface_rest;
+		send_settings();
+		flush();
+		read();
+	}
+
+	void http2_session::start(http::request req, std::string const& settings){
+		connection_->timeout(options_.header_timeout);
+		preface_ = client_preface;
+
+		// The client has sent its settings with the upgrade request
+		std::string payload;
+		if(!base64url_decode(settings, payload) || payload.size() % 6 != 0){
+			connection_error(protocol_error);
+			flush();
+			return;
+		}
+
+		send_settings();
+		if(!apply_settings(payload)){
+			flush();
+			return;
+		}
+
+		// Stream 1 is half closed by the client (RFC 7540 3.2)
+		auto const stream = std::make_shared< struct stream >();
+		stream->id = 1;
+		stream->send_window = initial_send_window_;
+		stream->receive_window = 0;
+		stream->remote_closed = true;
+		stream->req = std::move(req);
+		stream->req.http_version_major = 2;
+		stream->req.http_version_minor = 0;
+		for(auto iter = stream->req.headers.begin();
+			iter != stream->req.headers.end();
+		){
+			if(boost::algorithm::iequals(iter->first, "HTTP2-Settings")
+				|| boost::algorithm::iequals(iter->first, "Upgrade")
+				|| boost::algorithm::iequals(iter->first, "Connection")
+			){
+				iter = stream->req.headers.erase(iter);
+			}else{
+				++iter;
+			}
+		}
+
+		last_stream_id_ = 1;
+		streams_.emplace(stream->id, stream);
+		handle_request(stream);
+
+		flush();
+		read();
+	}
+
+	void http2_session::shutdown(){
+		if(closing_ || closed_) return;
+
+		// The client opens further streams on a new connection
+		if(streams_.empty()){
+			connection_error(no_error);
+		}else if(!going_away_){
+			going_away_ = true;
+			send_goaway(no_error);
+		}
+
+		flush();
+	}
+
+	void http2_session::read(){
+		auto shared_this = shared_from_this();
+		connection_->read_view([shared_this](
+			connection_ptr const& /*connection*/,
+			std::string_view data,
+			error_code const& err
+		){
+			return shared_this->receive(data, err);
+		});
+	}
+
+	std::size_t http2_session::receive(
+		std::string_view data,
+		error_code const& err
+	){
+		// The streams in process are dropped
+		if(err){
+			closed_ = true;
+			return 0;
+		}
+
+		if(closing_) return data.size();
+
+		std::size_t pos = 0;
+		if(!preface_.empty()){
+			auto const size = std::min(preface_.size(), data.size());
+			if(data.substr(0, size) != preface_.substr(0, size)){
+				// Not HTTP/2, the client can't understand an answer
+				closed_ = true;
+				connection_->shutdown(true);
+				return data.size();
+			}
+
+			preface_.remove_prefix(size);
+			pos = size;
+		}
+
+		while(preface_.empty() && data.size() - pos >= frame_header_size){
+			auto const begin = data.data() + pos;
+			frame_header header;
+			header.length = read_u24(begin);
+			header.type = static_cast< std::uint8_t >(begin[3]);
+			header.flags = static_cast< std::uint8_t >(begin[4]);
+			header.stream_id = read_u32(begin + 5) & 0x7fffffff;
+
+			if(header.length > max_frame_payload){
+				connection_error(frame_size_error);
+				break;
+			}
+
+			// Incomplete frames are passed again with the next data
+			if(data.size() - pos - frame_header_size < header.length) break;
+
+			pos += frame_header_size + header.length;
+			if(!handle_frame(header,
+				std::string_view(begin + frame_header_size, header.length))
+			) break;
+		}
+
+		update_timeout();
+		flush();
+		if(!closing_) read();
+		return pos;
+	}
+
+	bool http2_session::handle_frame(
+		frame_header const& header,
+		std::string_view data
+	){
+		// A header block must not be interrupted by other frames
+		if(continuation_stream_ != 0 && (header.type != continuation_frame
+			|| header.stream_id != continuation_stream_)
+		){
+			return connection_error(protocol_error);
+		}
+
+		// The client preface ends with a SETTINGS frame
+		if(!settings_received_ && header.type != settings_frame){
+			return connection_error(protocol_error);
+		}
+
+		switch(header.type){
+		case data_frame:
+			return handle_data(header, data);
+		case headers_frame:
+			return handle_headers(header, data);
+		case priority_frame:
+			// Priorities are ignored
+			if(header.stream_id == 0) return connection_error(protocol_error);
+			if(header.length != 5) return connection_error(frame_size_error);
+			return true;
+		case rst_stream_frame:
+			return handle_rst_stream(header, data);
+		case settings_frame:
+			return handle_settings(header, data);
+		case push_promise_frame:
+			// Only servers push
+			return connection_error(protocol_error);
+		case ping_frame:
+			return handle_ping(header, data);
+		case goaway_frame:
+			return handle_goaway(header, data);
+		case window_update_frame:
+			return handle_window_update(header, data);
+		case continuation_frame:
+			return handle_continuation(header, data);
+		default:
+			// Unknown frames are ignored (RFC 7540 4.1)
+			return true;
+		}
+	}
+
+	bool http2_session::handle_data(
+		frame_header const& header,
+		std::string_view data
+	){
+		if(header.stream_id == 0) return connection_error(protocol_error);
+
+		// The padding counts for the flow control
+		if(header.length > receive_window_){
+			return connection_error(flow_control_error);
+		}
+		receive_window_ -= header.length;
+
+		if(!strip_padding(header.flags, data)){
+			return connection_error(protocol_error);
+		}
+
+		auto const iter = streams_.find(header.stream_id);
+		if(iter == streams_.end() || iter->second->remote_closed){
+			if(header.stream_id > last_stream_id_){
+				return connection_error(protocol_error);
+			}
+
+			// Frames of reset streams may still arrive and are ignored
+			if(iter != streams_.end()){
+				reset_stream(iter->second, stream_closed);
+			}
+
+			consume(nullptr, header.length);
+			return true;
+		}
+
+		auto const stream = iter->second;
+		if(header.length > stream->receive_window){
+			reset_stream(stream, flow_control_error);
+			consume(nullptr, header.length);
+			return true;
+		}
+		stream->receive_window -= header.length;
+
+		if(!stream->dispatched){
+			if(stream->body_callback){
+				// The rest of the body is discarded
+				if(!stream->body_callback(data)) handle_request(stream);
+			}else if(
+				stream->req.body.size() + data.size() > options_.max_body_size
+			){
+				fail_request(stream, reply::request_entity_too_large);
+			}else{
+				stream->req.body.append(data);
+			}
+		}
+
+		if(header.flags & end_stream_flag){
+			stream->remote_closed = true;
+			if(!stream->dispatched) handle_request(stream);
+		}
+
+		consume(stream.get(), header.length);
+		return true;
+	}
+
+	bool http2_session::handle_headers(
+		frame_header const& header,
+		std::string_view data
+	){
+		if(header.stream_id == 0 || header.stream_id % 2 == 0){
+			return connection_error(protocol_error);
+		}
+
+		if(!strip_padding(header.flags, data)){
+			return connection_error(protocol_error);
+		}
+
+		// Priorities are ignored
+		if(header.flags & priority_flag){
+			if(data.size() < 5) return connection_error(frame_size_error);
+			data.remove_prefix(5);
+		}
+
+		if(data.size() > options_.http2_max_header_list_size){
+			return connection_error(enhance_your_calm);
+		}
+
+		header_stream_ = header.stream_id;
+		header_end_stream_ = (header.flags & end_stream_flag) != 0;
+		header_block_.assign(data);
+
+		if(header.flags & end_headers_flag) return finish_headers();
+
+		continuation_stream_ = header.stream_id;
+		return true;
+	}
+
+	bool http2_session::handle_continuation(
+		frame_header const& header,
+		std::string_view data
+	){
+		if(continuation_stream_ == 0) return connection_error(protocol_error);
+
+		if(header_block_.size() + data.size()
+			> options_.http2_max_header_list_size
+		){
+			return connection_error(enhance_your_calm);
+		}
+
+		header_block_.append(data);
+
+		if(header.flags & end_headers_flag){
+			continuation_stream_ = 0;
+			return finish_headers();
+		}
+
+		return true;
+	}
+
+	bool http2_session::finish_headers(){
+		// The decoder state is shared by all streams, so every block is
+		// decoded
+		hpack_field_list fields;
+		auto const result = decoder_.decode(header_block_, fields);
+		header_block_.clear();
+		if(result == hpack_decoder::invalid){
+			return connection_error(compression_error);
+		}
+
+		auto const iter = streams_.find(header_stream_);
+		if(iter == streams_.end()){
+			if(header_stream_ <= last_stream_id_){
+				// Frames in flight after RST_STREAM are ignored
+				if(std::find(reset_streams_.begin(), reset_streams_.end(),
+					header_stream_) != reset_streams_.end()
+				) return true;
+
+				// Identifiers of closed streams must not be reused
+				return connection_error(protocol_error);
+			}
+
+			last_stream_id_ = header_stream_;
+			open_stream(header_stream_, fields,
+				result == hpack_decoder::too_large);
+			return true;
+		}
+
+		// A trailer ends the request body
+		auto const stream = iter->second;
+		if(stream->remote_closed){
+			reset_stream(stream, stream_closed);
+			return true;
+		}
+
+		if(!header_end_stream_){
+			reset_stream(stream, protocol_error);
+			return true;
+		}
+
+		stream->remote_closed = true;
+		if(stream->dispatched) return true;
+
+		for(auto& field: fields){
+			if(!field.first.empty() && field.first[0] == ':'){
+				reset_stream(stream, protocol_error);
+				return true;
+			}
+
+			stream->req.headers.emplace(
+				canonical_name(std::move(field.first)),
+				std::move(field.second));
+		}
+
+		handle_request(stream);
+		return true;
+	}
+
+	void http2_session::open_stream(
+		std::uint32_t id,
+		hpack_field_list& fields,
+		bool too_large
+	){
+		auto const stream = std::make_shared< struct stream >();
+		stream->id = id;
+		stream->send_window = initial_send_window_;
+		stream->receive_window = receive_window_size(options_);
+		stream->remote_closed = header_end_stream_;
+
+		// The client may retry a refused stream on another connection
+		if(streams_.size() + orphaned_streams_
+				>= options_.http2_max_concurrent_streams
+			|| going_away_ || connection_manager_.draining()
+		){
+			reset_stream(stream, refused_stream);
+			return;
+		}
+
+		streams_.emplace(id, stream);
+
+		if(too_large){
+			fail_request(stream, reply::request_header_fields_too_large);
+			return;
+		}
+
+		if(!make_request(stream->req, fields)){
+			reset_stream(stream, protocol_error);
+			return;
+		}
+
+		if(stream->remote_closed){
+			handle_request(stream);
+			return;
+		}
+
+		// The request has a body
+		stream->body_callback = request_handler_.stream_body(
+			connection_, stream->req);
+		if(!stream->body_callback
+			&& content_length(stream->req.headers) > options_.max_body_size
+		){
+			fail_request(stream, reply::request_entity_too_large);
+		}
+	}
+
+	bool http2_session::make_request(
+		http::request& req,
+		hpack_field_list& fields
+	){
+		req.http_version_major = 2;
+		req.http_version_minor = 0;
+
+		std::string path;
+		std::string scheme;
+		std::string authority;
+		std::string cookie;
+		bool regular = false;
+		for(auto& field: fields){
+			auto const& name = field.first;
+			if(std::any_of(name.begin(), name.end(),
+				[](char c){ return c >= 'A' && c <= 'Z'; })
+			){
+				return false;
+			}
+
+			// Pseudo-header fields precede the regular fields
+			if(!name.empty() && name[0] == ':'){
+				std::string* target = nullptr;
+				if(name == ":method"){
+					target = &req.method;
+				}else if(name == ":path"){
+					target = &path;
+				}else if(name == ":scheme"){
+					target = &scheme;
+				}else if(name == ":authority"){
+					target = &authority;
+				}
+
+				if(regular || !target || !target->empty()) return false;
+
+				*target = std::move(field.second);
+				continue;
+			}
+			regular = true;
+
+			if(is_connection_field(name)) return false;
+			if(name == "te" && field.second != "trailers") return false;
+
+			// Split cookies are joined for HTTP/1 handlers
+			// (RFC 7540 8.1.2.5)
+			if(name == "cookie"){
+				if(!cookie.empty()) cookie += "; ";
+				cookie += field.second;
+				continue;
+			}
+
+			req.headers.emplace(
+				canonical_name(std::move(field.first)),
+				std::move(field.second));
+		}
+
+		if(!cookie.empty()) req.headers.emplace("Cookie", std::move(cookie));
+
+		// CONNECT is not supported
+		if(req.method.empty() || req.method == "CONNECT"
+			|| path.empty() || scheme.empty()
+		){
+			return false;
+		}
+
+		if(!authority.empty() && req.headers.count("Host") == 0){
+			req.headers.emplace("Host", std::move(authority));
+		}
+
+		return request_parser::url_decode(path, req.uri);
+	}
+
+	void http2_session::handle_request(stream_ptr const& stream){
+		// Too many requests in process, shed the load
+		if(!connection_manager_.add_request()){
+			auto rep = reply::stock_reply(reply::service_unavailable);
+			rep.headers.insert(std::make_pair("Retry-After",
+				std::to_string(options_.retry_after.count())));
+			fail_request(stream, std::move(rep));
+			return;
+		}
+
+		stream->dispatched = true;
+		stream->handling = true;
+		stream->body_callback = body_fn();
+
+		// The handler may complete from any thread, the io_service must run
+		// until the completion is handled
+		auto shared_this = shared_from_this();
+		request_handler_.async_handle_request(
+			connection_, stream->req, stream->rep,
+			[shared_this, stream,
+				work = asio::io_service::work(connection_->io_service())
+			]{
+				shared_this->connection_->post([shared_this, stream, work]{
+					shared_this->complete_request(stream);
+				});
+			});
+	}
+
+	void http2_session::complete_request(stream_ptr const& stream){
+		stream->handling = false;
+		connection_manager_.remove_requests(1);
+
+		// The stream was reset, it doesn't count as open anymore
+		if(stream->closed){
+			--orphaned_streams_;
+			return;
+		}
+
+		// The connection has failed
+		if(closing_ || closed_) return;
+
+		send_reply(stream);
+		update_timeout();
+		flush();
+	}
+
+	void http2_session::fail_request(
+		stream_ptr const& stream,
+		reply::status_type status
+	){
+		fail_request(stream, reply::stock_reply(status));
+	}
+
+	void http2_session::fail_request(
+		stream_ptr const& stream,
+		http::reply rep
+	){
+		stream->dispatched = true;
+		stream->body_callback = body_fn();
+		stream->rep = std::move(rep);
+		send_reply(stream);
+	}
+
+	void http2_session::send_reply(stream_ptr const& stream){
+		auto& rep = stream->rep;
+		bool const body = reply::has_body(rep.status);
+
+		std::string block;
+		hpack_encode(block, ":status", std::to_string(rep.status));
+
+		bool has_length = false;
+		for(auto const& field: rep.headers){
+			auto const name = boost::algorithm::to_lower_copy(field.first);
+			if(is_connection_field(name)) continue;
+
+			has_length = has_length || name == "content-length";
+			hpack_encode(block, name, field.second);
+		}
+
+		if(body && !rep.producer && !has_length){
+			hpack_encode(block, "content-length",
+				std::to_string(rep.content.size()));
+		}
+
+		bool const end_stream = !body || (!rep.producer && rep.content.empty());
+
+		// Header blocks larger than a frame are continued
+		std::string_view rest(block);
+		std::uint8_t type = headers_frame;
+		do{
+			auto const fragment = rest.substr(0, max_frame_size_);
+			rest.remove_prefix(fragment.size());
+
+			std::uint8_t flags = rest.empty() ? end_headers_flag : 0;
+			if(type == headers_frame && end_stream) flags |= end_stream_flag;
+
+			write_frame(type, flags, stream->id, fragment);
+			type = continuation_frame;
+		}while(!rest.empty());
+
+		stream->replied = true;
+		if(end_stream){
+			finish_stream(stream);
+			return;
+		}
+
+		if(rep.producer){
+			stream->producing = true;
+		}else{
+			stream->data = std::move(rep.content);
+		}
+
+		send_data(stream);
+	}
+
+	void http2_session::send_data(stream_ptr const& stream){
+		for(;;){
+			// Continued by handle_write()
+			if(backpressure()){
+				blocked_ = true;
+				return;
+			}
+
+			auto const window = std::max< std::int64_t >(
+				std::min(stream->send_window, send_window_), 0);
+
+			// The next pieces are produced when the previous ones are sent,
+			// small pieces are collected into one frame
+			if(stream->data_sent == stream->data.size() && stream->producing){
+				if(window == 0) return;
+
+				stream->data.clear();
+				stream->data_sent = 0;
+				while(stream->producing
+					&& stream->data.size() < max_frame_size_
+				){
+					stream->producing = stream->rep.producer(stream->data);
+				}
+				continue;
+			}
+
+			// Continued by handle_window_update()
+			auto const rest = stream->data.size() - stream->data_sent;
+			auto const size = static_cast< std::size_t >(
+				std::min< std::int64_t >({static_cast< std::int64_t >(rest),
+					window, static_cast< std::int64_t >(max_frame_size_)}));
+			if(size == 0 && rest > 0) return;
+
+			bool const last = !stream->producing && size == rest;
+			write_frame(data_frame, last ? end_stream_flag : 0, stream->id,
+				std::string_view(stream->data).substr(stream->data_sent, size));
+			stream->data_sent += size;
+			stream->send_window -= size;
+			send_window_ -= size;
+
+			if(last){
+				finish_stream(stream);
+				return;
+			}
+		}
+	}
+
+	void http2_session::send_all(){
+		blocked_ = false;
+
+		// Streams are erased when they are finished
+		std::vector< stream_ptr > streams;
+		for(auto const& entry: streams_){
+			if(entry.second->replied) streams.push_back(entry.second);
+		}
+
+		for(auto const& stream: streams){
+			if(blocked_) return;
+			if(!stream->closed) send_data(stream);
+		}
+	}
+
+	void http2_session::finish_stream(stream_ptr const& stream){
+		stream->closed = true;
+		stream->data = std::string();
+
+		// The rest of the request body is not needed (RFC 7540 8.1)
+		if(!stream->remote_closed) send_rst_stream(*stream, no_error);
+
+		streams_.erase(stream->id);
+		close_if_drained();
+	}
+
+	void http2_session::reset_stream(
+		stream_ptr const& stream,
+		error_code_type error
+	){
+		// The handler still runs
+		if(stream->handling) ++orphaned_streams_;
+
+		stream->closed = true;
+		stream->body_callback = body_fn();
+		stream->data = std::string();
+		send_rst_stream(*stream, error);
+
+		streams_.erase(stream->id);
+		close_if_drained();
+	}
+
+	void http2_session::send_rst_stream(
+		stream const& stream,
+		error_code_type error
+	){
+		std::string payload;
+		append_u32(payload, error);
+		write_frame(rst_stream_frame, 0, stream.id, payload);
+
+		// Remember the latest streams, on which the client may still send
+		if(!stream.remote_closed){
+			reset_streams_.push_back(stream.id);
+			if(reset_streams_.size() > options_.http2_max_concurrent_streams){
+				reset_streams_.pop_front();
+			}
+		}
+	}
+
+	void http2_session::close_if_drained(){
+		// The client opens further streams on a new connection
+		if((going_away_ || connection_manager_.draining())
+			&& streams_.empty()
+		){
+			connection_error(no_error);
+		}
+	}
+
+	void http2_session::update_timeout(){
+		// The header timeout set by start() runs until the client preface
+		// is complete
+		if(!settings_received_ || closing_ || closed_) return;
+
+		bool const idle = streams_.empty();
+		if(idle_ == idle) return;
+
+		idle_ = idle;
+		connection_->timeout(idle
+			? options_.idle_timeout : std::chrono::milliseconds(0));
+	}
+
+	bool http2_session::handle_rst_stream(
+		frame_header const& header,
+		std::string_view /*data*/
+	){
+		if(header.stream_id == 0 || header.stream_id > last_stream_id_){
+			return connection_error(protocol_error);
+		}
+
+		if(header.length != 4) return connection_error(frame_size_error);
+
+		auto const iter = streams_.find(header.stream_id);
+		if(iter == streams_.end()) return true;
+
+		// Resetting streams in a loop keeps the server busy
+		++client_resets_;
+		if(options_.http2_max_resets != 0
+			&& client_resets_ > options_.http2_max_resets
+		){
+			return connection_error(enhance_your_calm);
+		}
+
+		// A running handler completes without effect, until then the stream
+		// counts against the concurrent streams
+		auto const stream = iter->second;
+		if(stream->handling) ++orphaned_streams_;
+		stream->closed = true;
+		stream->body_callback = body_fn();
+		stream->data = std::string();
+		streams_.erase(iter);
+		close_if_drained();
+		return true;
+	}
+
+	bool http2_session::handle_settings(
+		frame_header const& header,
+		std::string_view data
+	){
+		if(header.stream_id != 0) return connection_error(protocol_error);
+
+		if(header.flags & ack_flag){
+			if(header.length != 0) return connection_error(frame_size_error);
+			return true;
+		}
+
+		if(header.length % 6 != 0) return connection_error(frame_size_error);
+
+		settings_received_ = true;
+		if(!apply_settings(data)) return false;
+
+		write_frame(settings_frame, ack_flag, 0, std::string_view());
+
+		// The initial window may have grown
+		send_all();
+		return true;
+	}
+
+	bool http2_session::apply_settings(std::string_view data){
+		for(; data.size() >= 6; data.remove_prefix(6)){
+			auto const id = read_u16(data.data());
+			auto const value = read_u32(data.data() + 2);
+			switch(id){
+			case settings_enable_push:
+				if(value > 1) return connection_error(protocol_error);
+				break;
+			case settings_initial_window_size:{
+				if(value > max_window){
+					return connection_error(flow_control_error);
+				}
+
+				// Applies to the windows of all streams (RFC 7540 6.9.2)
+				auto const delta = std::int64_t(value) - initial_send_window_;
+				initial_send_window_ = value;
+				for(auto const& entry: streams_){
+					entry.second->send_window += delta;
+					if(entry.second->send_window > max_window){
+						return connection_error(flow_control_error);
+					}
+				}
+			}break;
+			case settings_max_frame_size:
+				if(value < 16384 || value > 16777215){
+					return connection_error(protocol_error);
+				}
+				max_frame_size_ = value;
+				break;
+			default:
+				// The encoder doesn't use a dynamic table and the server
+				// doesn't push, the other settings don't matter
+				break;
+			}
+		}
+
+		return true;
+	}
+
+	bool http2_session::handle_ping(
+		frame_header const& header,
+		std::string_view data
+	){
+		if(header.stream_id != 0) return connection_error(protocol_error);
+		if(header.length != 8) return connection_error(frame_size_error);
+
+		if((header.flags & ack_flag) == 0){
+			write_frame(ping_frame, ack_flag, 0, data);
+		}
+
+		return true;
+	}
+
+	bool http2_session::handle_goaway(
+		frame_header const& header,
+		std::string_view /*data*/
+	){
+		if(header.stream_id != 0) return connection_error(protocol_error);
+		if(header.length < 8) return connection_error(frame_size_error);
+
+		// The client closes the connection after its open streams
+		return true;
+	}
+
+	bool http2_session::handle_window_update(
+		frame_header const& header,
+		std::string_view data
+	){
+		if(header.length != 4) return connection_error(frame_size_error);
+
+		auto const increment = read_u32(data.data()) & 0x7fffffff;
+		if(header.stream_id == 0){
+			if(increment == 0) return connection_error(protocol_error);
+
+			send_window_ += increment;
+			if(send_window_ > max_window){
+				return connection_error(flow_control_error);
+			}
+
+			send_all();
+			return true;
+		}
+
+		auto const iter = streams_.find(header.stream_id);
+		if(iter == streams_.end()){
+			if(header.stream_id > last_stream_id_){
+				return connection_error(protocol_error);
+			}
+
+			return true;
+		}
+
+		auto const stream = iter->second;
+		if(increment == 0){
+			reset_stream(stream, protocol_error);
+			return true;
+		}
+
+		stream->send_window += increment;
+		if(stream->send_window > max_window){
+			reset_stream(stream, flow_control_error);
+			return true;
+		}
+
+		if(stream->replied && !blocked_) send_data(stream);
+		return true;
+	}
+
+	void http2_session::consume(stream* stream, std::size_t size){
+		auto const window = receive_window_size(options_);
+
+		received_ += size;
+		if(received_ >= static_cast< std::size_t >(window / 2)){
+			std::string payload;
+			append_u32(payload, static_cast< std::uint32_t >(received_));
+			write_frame(window_update_frame, 0, 0, payload);
+			receive_window_ += received_;
+			received_ = 0;
+		}
+
+		// Closed streams receive nothing anymore
+		if(!stream || stream->remote_closed) return;
+
+		stream->received += size;
+		if(stream->received >= static_cast< std::size_t >(window / 2)){
+			std::string payload;
+			append_u32(payload, static_cast< std::uint32_t >(stream->received));
+			write_frame(window_update_frame, 0, stream->id, payload);
+			stream->receive_window += stream->received;
+			stream->received = 0;
+		}
+	}
+
+	void http2_session::send_settings(){
+		auto const window = receive_window_size(options_);
+
+		auto const limit = [](std::size_t value){
+				return static_cast< std::uint32_t >(std::min< std::size_t >(
+					value, std::numeric_limits< std::uint32_t >::max()));
+			};
+
+		std::string payload;
+		append_u16(payload, settings_max_concurrent_streams);
+		append_u32(payload, limit(options_.http2_max_concurrent_streams));
+		append_u16(payload, settings_initial_window_size);
+		append_u32(payload, static_cast< std::uint32_t >(window));
+		append_u16(payload, settings_max_header_list_size);
+		append_u32(payload, limit(options_.http2_max_header_list_size));
+		write_frame(settings_frame, 0, 0, payload);
+
+		// The connection window is only changed by WINDOW_UPDATE
+		if(window > receive_window_){
+			payload.clear();
+			append_u32(payload,
+				static_cast< std::uint32_t >(window - receive_window_));
+			write_frame(window_update_frame, 0, 0, payload);
+			receive_window_ = window;
+		}
+	}
+
+	bool http2_session::connection_error(error_code_type error){
+		if(closing_) return false;
+		closing_ = true;
+
+		send_goaway(error);
+		return false;
+	}
+
+	void http2_session::send_goaway(error_code_type error){
+		std::string payload;
+		append_u32(payload, last_stream_id_);
+		append_u32(payload, error);
+		write_frame(goaway_frame, 0, 0, payload);
+	}
+
+	void http2_session::write_frame(
+		std::uint8_t type,
+		std::uint8_t flags,
+		std::uint32_t stream_id,
+		std::string_view payload
+	){
+		append_u24(output_, static_cast< std::uint32_t >(payload.size()));
+		output_.push_back(static_cast< char >(type));
+		output_.push_back(static_cast< char >(flags));
+		append_u32(output_, stream_id);
+		output_.append(payload);
+	}
+
+	void http2_session::flush(){
+		if(output_.empty() || closed_) return;
+
+		auto shared_this = shared_from_this();
+		connection_->write(
+			std::make_shared< std::string const >(std::move(output_)),
+			[shared_this](connection_ptr const&, error_code const& err){
+				shared_this->handle_write(err);
+			});
+		output_.clear();
+	}
+
+	void http2_session::handle_write(error_code const& err){
+		if(err){
+			closed_ = true;
+			return;
+		}
+
+		// The GOAWAY frame is written
+		if(closing_){
+			if(connection_->queued_bytes() == 0) connection_->shutdown(true);
+			return;
+		}
+
+		if(blocked_ && !backpressure()){
+			send_all();
+			update_timeout();
+			flush();
+		}
+	}
+
+	bool http2_session::backpressure()const{
+		return options_.write_high_water_mark != 0
+			&& connection_->queued_bytes() + output_.size()
+				> options_.write_high_water_mark;
+	}
+
+
+}
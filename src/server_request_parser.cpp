@@ -26,6 +26,10 @@ namespace http::server{
 		state_ = method_start;
 	}
 
+	bool request_parser::initial()const{
+		return state_ == method_start;
+	}
+
 	boost::tribool request_parser::consume(http::request& req, char input){
 		switch(state_){
 		case method_start:
@@ -8,43 +8,328 @@
 //-----------------------------------------------------------------------------
 #include <http/server_server.hpp>
 
+#include "server_socket_option.hpp"
+
 #include <logsys/log.hpp>
 #include <logsys/stdlogb.hpp>
 
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 #include <thread>
 #include <memory>
 #include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 namespace http::server{
 
 
+	namespace{
+
+
+		/// \brief Set a socket option, a failure is logged
+		template < typename Socket, typename Option >
+		void set_option(Socket& socket, Option const& option, char const* name){
+			error_code err;
+			socket.set_option(option, err);
+			if(err){
+				logsys::log([name, &err](logsys::stdlogb& os){
+					os << "Error: set socket option " << name << ": "
+						<< err.message();
+				});
+			}
+		}
+
+		/// \brief Set the options, that listening and accepted sockets
+		///        have in common
+		template < typename Socket >
+		void set_common_options(
+			Socket& socket,
+			http::server::socket_options const& options
+		){
+			set_option(socket, tcp::no_delay(options.tcp_no_delay),
+				"TCP_NODELAY");
+
+			if(!options.keep_alive) return;
+
+			set_option(socket, asio::socket_base::keep_alive(true),
+				"SO_KEEPALIVE");
+#ifdef TCP_KEEPIDLE
+			if(options.keep_alive_idle.count() != 0){
+				set_option(socket, keep_alive_idle(static_cast< int >(
+					options.keep_alive_idle.count())), "TCP_KEEPIDLE");
+			}
+#endif
+#ifdef TCP_KEEPINTVL
+			if(options.keep_alive_interval.count() != 0){
+				set_option(socket, keep_alive_interval(static_cast< int >(
+					options.keep_alive_interval.count())), "TCP_KEEPINTVL");
+			}
+#endif
+#ifdef TCP_KEEPCNT
+			if(options.keep_alive_count != 0){
+				set_option(socket, keep_alive_count(options.keep_alive_count),
+					"TCP_KEEPCNT");
+			}
+#endif
+		}
+
+		/// \brief Read a socket option, keep the value on failure
+		template < typename Option, typename Acceptor, typename Value >
+		void get_option(
+			Acceptor const& acceptor,
+			Value& value
+		){
+			Option option;
+			error_code err;
+			acceptor.get_option(option, err);
+			if(!err) value = static_cast< Value >(option.value());
+		}
+
+
+		/// \brief Name the calling thread and pin it to the CPUs
+		void configure_thread(
+			std::string const& name,
+			std::vector< unsigned > const& cpus
+		){
+#ifdef __linux__
+			// Linux thread names have at most 15 characters
+			pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+
+			if(cpus.empty()) return;
+
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			for(auto const cpu: cpus){
+				CPU_SET(cpu, &set);
+			}
+
+			if(auto const err = pthread_setaffinity_np(
+				pthread_self(), sizeof(set), &set)
+			){
+				logsys::log([&name, err](logsys::stdlogb& os){
+					os << "Error: set CPU affinity of thread " << name
+						<< ": " << std::strerror(err);
+				});
+			}
+#else
+			(void)name;
+			(void)cpus;
+#endif
+		}
+
+		/// \brief Throw if a CPU index doesn't fit into a cpu_set_t
+		void check_cpus(std::vector< unsigned > const& cpus){
+#ifdef __linux__
+			for(auto const cpu: cpus){
+				if(cpu >= CPU_SETSIZE){
+					throw std::invalid_argument("CPU index "
+						+ std::to_string(cpu) + " exceeds CPU_SETSIZE "
+						+ std::to_string(CPU_SETSIZE));
+				}
+			}
+#else
+			(void)cpus;
+#endif
+		}
+
+
+		/// \brief Endpoints of Unix domain sockets start with this prefix
+		constexpr std::string_view unix_prefix = "unix:";
+
+		/// \brief Check if an endpoint is a Unix domain socket path
+		bool is_unix_endpoint(std::string const& endpoint){
+			return endpoint.compare(0, unix_prefix.size(), unix_prefix) == 0;
+		}
+
+		/// \brief Remove a Unix domain socket file, other files are kept
+		void remove_unix_socket(std::string const& path){
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+			struct stat status;
+			if(::stat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)){
+				::unlink(path.c_str());
+			}
+#else
+			(void)path;
+#endif
+		}
+
+
+		/// \brief Split an endpoint into host (may be empty) and port
+		std::pair< std::string, std::string > split_endpoint(
+			std::string const& endpoint
+		){
+			auto const colon = endpoint.rfind(':');
+			if(colon == std::string::npos) return {std::string(), endpoint};
+
+			// IPv6 addresses are enclosed in brackets
+			std::string host = endpoint.substr(0, colon);
+			if(host.size() >= 2 && host.front() == '[' && host.back() == ']'){
+				host = host.substr(1, host.size() - 2);
+			}
+
+			return {host, endpoint.substr(colon + 1)};
+		}
+
+		/// \brief Resolve an endpoint string
+		tcp::endpoint resolve(
+			tcp::resolver& resolver,
+			std::string const& endpoint
+		){
+			auto const [host, port] = split_endpoint(endpoint);
+			if(host.empty()){
+				tcp::resolver::query query(port);
+				return *resolver.resolve(query);
+			}else{
+				tcp::resolver::query query(host, port);
+				return *resolver.resolve(query);
+			}
+		}
+
+
+	}
+
+
+	server::shard::shard(
+		int concurrency_hint,
+		http::server::options const& options,
+		http::server::connection_manager& connection_manager
+	):
+		io_service(concurrency_hint),
+		timers(io_service, options.timer_resolution),
+		pool(std::make_shared< connection_pool >(
+			io_service, options, timers, connection_manager))
+		{}
+
+
 	server::server(
 		std::string const& port,
 		request_handler& handler,
-		std::size_t thread_pool_size
+		std::size_t thread_pool_size,
+		http::server::options const& options
+	):
+		server(std::vector< std::string >{port}, handler, thread_pool_size,
+			options)
+		{}
+
+	server::server(
+		std::vector< std::string > const& endpoint_names,
+		request_handler& handler,
+		std::size_t thread_pool_size,
+		http::server::options const& options
 	):
 		request_handler_(handler),
-		acceptor_(io_service_)
+		options_(options),
+		connection_manager_(options_)
 	{
-		// Open the acceptor with the option to reuse the address
-		// (i.e. SO_REUSEADDR).
-		tcp::resolver resolver(io_service_);
-		tcp::resolver::query query(port);
-		tcp::endpoint endpoint = *resolver.resolve(query);
-		acceptor_.open(endpoint.protocol());
-		acceptor_.set_option(tcp::acceptor::reuse_address(true));
+		if(options_.backend != compiled_io_backend){
+			throw std::runtime_error(options_.backend == io_backend::io_uring
+				? "io_uring backend requires a build with "
+					"BOOST_ASIO_HAS_IO_URING and BOOST_ASIO_DISABLE_EPOLL"
+				: "Reactor backend requires a build without "
+					"BOOST_ASIO_DISABLE_EPOLL");
+		}
+
+		for(auto const& cpus: options_.io_thread_cpus) check_cpus(cpus);
+		check_cpus(options_.accept_thread_cpus);
+
+		bool const sharded = options_.mode == execution_mode::sharded;
+
+#ifndef SO_REUSEPORT
+		if(sharded && !options_.dedicated_accept_thread){
+			throw std::runtime_error(
+				"Sharded execution mode requires SO_REUSEPORT or a dedicated "
+				"accept thread");
+		}
+#endif
+
+		// In sharded mode every thread runs its own io_service
+		std::size_t const shard_count =
+			sharded ? std::max< std::size_t >(thread_pool_size, 1) : 1;
+		int const concurrency_hint = sharded
+			? 1 : static_cast< int >(thread_pool_size);
+		shards_.reserve(shard_count);
+		for(std::size_t i = 0; i < shard_count; ++i){
+			shards_.push_back(std::make_unique< shard >(
+				concurrency_hint, options_, connection_manager_));
+		}
+
+		// Either the accept thread or every shard listens
+		if(options_.dedicated_accept_thread){
+			accept_shard_ = std::make_unique< shard >(
+				1, options_, connection_manager_);
+			listeners_.push_back(accept_shard_.get());
+
+			for(auto& shard: shards_){
+				shard->work.emplace(shard->io_service);
+			}
+		}else{
+			for(auto& shard: shards_){
+				listeners_.push_back(shard.get());
+			}
+		}
+
+		for(auto listener: listeners_){
+			listener->acceptors.reserve(endpoint_names.size());
+		}
+
+		tcp::resolver resolver(shards_.front()->io_service);
+		std::vector< std::optional< tcp::endpoint > > endpoints;
+		endpoints.reserve(endpoint_names.size());
+		for(auto const& name: endpoint_names){
+			if(is_unix_endpoint(name)){
+				endpoints.emplace_back();
+			}else{
+				endpoints.emplace_back(resolve(resolver, name));
+			}
+		}
 
-		try{
-			acceptor_.bind(endpoint);
-		}catch(std::runtime_error const& error){
-			throw std::runtime_error("Binding server to endpoint failed (Port: "
-				+ port + "); " + error.what());
+		for(std::size_t i = 0; i < endpoints.size(); ++i){
+			try{
+				if(endpoints[i]){
+					listen_tcp(*endpoints[i], endpoints);
+				}else{
+					listen_unix(endpoint_names[i].substr(unix_prefix.size()));
+				}
+			}catch(std::runtime_error const& error){
+				throw std::runtime_error(
+					"Binding server to endpoint failed (Endpoint: "
+					+ endpoint_names[i] + "); " + error.what());
+			}
 		}
 
-		acceptor_.listen();
+		logsys::log([this](logsys::stdlogb& os){
+			auto const socket = effective_socket_options();
+			os << "http server socket options: TCP_NODELAY "
+				<< socket.tcp_no_delay << ", TCP_DEFER_ACCEPT "
+				<< socket.defer_accept.count() << " s, TCP_FASTOPEN "
+				<< socket.fast_open_queue << ", SO_SNDBUF "
+				<< socket.send_buffer_size << ", SO_RCVBUF "
+				<< socket.receive_buffer_size << ", TCP_QUICKACK "
+				<< socket.quick_ack << ", SO_KEEPALIVE " << socket.keep_alive
+				<< " (" << socket.keep_alive_idle.count() << " s, "
+				<< socket.keep_alive_interval.count() << " s, "
+				<< socket.keep_alive_count << ")";
+		});
+
+		// Closed connections resume acceptors paused by overload
+		connection_manager_.resume_callback([this]{ resume_accept(); });
 
-		start_accept();
+		for(auto listener: listeners_){
+			for(auto& acceptor: listener->acceptors){
+				start_accept(*listener, acceptor);
+			}
+		}
 
 		run(thread_pool_size);
 	}
@@ -53,61 +338,458 @@ namespace http::server{
 		logsys::exception_catching_log(
 			[](logsys::stdlogb& os){ os << "destruct http server"; },
 			[this]{
-				// Do not accept new connections
-				stop_accept();
-
-				// Tell the handler that the server shutdowns
-				request_handler_.shutdown();
+				if(!drained_){
+					drain(options_.shutdown_timeout);
+				}
 
 				for(auto& future: futures_){
 					if(future.valid()) future.wait();
 				}
+
+				for(auto const& path: unix_paths_){
+					remove_unix_socket(path);
+				}
 			});
 	}
 
+	server::drain_statistics server::drain(std::chrono::milliseconds timeout){
+		auto const deadline = std::chrono::steady_clock::now() + timeout;
+
+		drain_statistics result;
+		result.connections = connection_manager_.connections();
+		result.requests = connection_manager_.requests();
+
+		if(!drained_.exchange(true)){
+			// Do not accept new connections
+			{
+				std::lock_guard< std::mutex > lock(paused_mutex_);
+				stopped_ = true;
+				paused_acceptors_.clear();
+			}
+
+			for(auto listener: listeners_){
+				stop_accept(*listener);
+			}
+
+			// The I/O threads run until the connections are closed, if
+			// need be by force
+			for(auto& shard: shards_){
+				shard->work.emplace(shard->io_service);
+			}
+
+			// Persistent connections close after their next reply
+			connection_manager_.start_drain();
+
+			// Tell the handler that the server shutdowns
+			request_handler_.shutdown();
+
+			for(auto& connection:
+				connection_manager_.registered_connections()
+			){
+				connection->shutdown(false);
+			}
+		}
+
+		if(!connection_manager_.wait_closed(deadline)){
+			auto const connections =
+				connection_manager_.registered_connections();
+			result.forced = connections.size();
+			for(auto& connection: connections){
+				connection->shutdown(true);
+			}
+		}
+
+		// The I/O threads end after the last posted operation
+		for(auto& shard: shards_){
+			shard->work.reset();
+		}
+
+		result.closed = result.connections > result.forced
+			? result.connections - result.forced : 0;
+
+		logsys::log([&result](logsys::stdlogb& os){
+			os << "drain http server: " << result.connections
+				<< " connections with " << result.requests
+				<< " requests, " << result.closed << " closed, "
+				<< result.forced << " forced";
+		});
+
+		return result;
+	}
+
+	connection_pool::statistics server::connection_pool_statistics()const{
+		connection_pool::statistics result;
+		for(auto const& shard: shards_){
+			auto const statistics = shard->pool->get_statistics();
+			result.created += statistics.created;
+			result.reused += statistics.reused;
+			result.recycled += statistics.recycled;
+			result.discarded += statistics.discarded;
+			result.idle += statistics.idle;
+		}
+		return result;
+	}
+
+	socket_options server::effective_socket_options()const{
+		auto result = options_.socket;
+
+		// Unix domain sockets have no TCP options
+		auto const& acceptors = listeners_.front()->acceptors;
+		auto const iter = std::find_if(acceptors.begin(), acceptors.end(),
+			[](listen_socket const& acceptor){ return acceptor.tcp; });
+		if(iter == acceptors.end()) return result;
+
+		auto const& acceptor = *iter;
+		get_option< tcp::no_delay >(acceptor, result.tcp_no_delay);
+		get_option< asio::socket_base::send_buffer_size >(
+			acceptor, result.send_buffer_size);
+		get_option< asio::socket_base::receive_buffer_size >(
+			acceptor, result.receive_buffer_size);
+		get_option< asio::socket_base::keep_alive >(
+			acceptor, result.keep_alive);
+#ifdef TCP_DEFER_ACCEPT
+		int defer = 0;
+		get_option< defer_accept >(acceptor, defer);
+		result.defer_accept = std::chrono::seconds(defer);
+#endif
+#ifdef TCP_FASTOPEN
+		get_option< fast_open >(acceptor, result.fast_open_queue);
+#endif
+#ifdef TCP_KEEPIDLE
+		int idle = 0;
+		get_option< keep_alive_idle >(acceptor, idle);
+		result.keep_alive_idle = std::chrono::seconds(idle);
+#endif
+#ifdef TCP_KEEPINTVL
+		int interval = 0;
+		get_option< keep_alive_interval >(acceptor, interval);
+		result.keep_alive_interval = std::chrono::seconds(interval);
+#endif
+#ifdef TCP_KEEPCNT
+		get_option< keep_alive_count >(acceptor, result.keep_alive_count);
+#endif
+		return result;
+	}
+
+	std::size_t server::connections()const{
+		return connection_manager_.connections();
+	}
+
+	std::size_t server::inflight_requests()const{
+		return connection_manager_.requests();
+	}
+
+	void server::listen_tcp(
+		tcp::endpoint const& endpoint,
+		std::vector< std::optional< tcp::endpoint > > const& endpoints
+	){
+		// An IPv6 socket must not take the port of an IPv4 endpoint
+		bool const v6_only = endpoint.address().is_v6()
+			&& std::any_of(endpoints.begin(), endpoints.end(),
+				[&endpoint](std::optional< tcp::endpoint > const& other){
+					return other && other->address().is_v4()
+						&& other->port() == endpoint.port();
+				});
+
+		for(auto listener: listeners_){
+			listen(*listener, endpoint, true, v6_only);
+		}
+	}
+
+	void server::listen_unix(std::string const& path){
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+		// The socket file of a previous run would block the bind
+		remove_unix_socket(path);
+
+		// Only one socket can be bound to the path
+		auto& acceptor = listen(*listeners_.front(),
+			asio::local::stream_protocol::endpoint(path), false, false);
+		acceptor.distribute = listeners_.size() > 1;
+		unix_paths_.push_back(path);
+#else
+		(void)path;
+		throw std::runtime_error("Unix domain sockets are not supported");
+#endif
+	}
+
+	server::listen_socket& server::listen(
+		shard& shard,
+		stream_protocol::endpoint const& endpoint,
+		bool tcp,
+		bool v6_only
+	){
+		shard.acceptors.emplace_back(shard.io_service);
+		auto& acceptor = shard.acceptors.back();
+		acceptor.tcp = tcp;
+
+		acceptor.open(endpoint.protocol());
+
+		auto const& socket = options_.socket;
+		if(tcp){
+			// Reuse the address (i.e. SO_REUSEADDR).
+			acceptor.set_option(listen_socket::reuse_address(true));
+
+			if(v6_only){
+				acceptor.set_option(asio::ip::v6_only(true));
+			}
+
+#ifdef SO_REUSEPORT
+			// Every shard listens on its own socket, the kernel distributes
+			// the incoming connections
+			if(listeners_.size() > 1){
+				acceptor.set_option(reuse_port(true));
+			}
+#endif
+
+			set_common_options(acceptor, socket);
+
+#ifdef TCP_DEFER_ACCEPT
+			if(socket.defer_accept.count() != 0){
+				set_option(acceptor, defer_accept(static_cast< int >(
+					socket.defer_accept.count())), "TCP_DEFER_ACCEPT");
+			}
+#endif
+		}
+
+		// Accepted sockets inherit the buffer sizes, the receive buffer
+		// must be set before listen to take effect on the window scale
+		if(socket.send_buffer_size != 0){
+			set_option(acceptor,
+				asio::socket_base::send_buffer_size(socket.send_buffer_size),
+				"SO_SNDBUF");
+		}
+		if(socket.receive_buffer_size != 0){
+			set_option(acceptor, asio::socket_base::receive_buffer_size(
+				socket.receive_buffer_size), "SO_RCVBUF");
+		}
+
+		acceptor.bind(endpoint);
+
+#ifdef TCP_FASTOPEN
+		if(tcp && socket.fast_open_queue != 0){
+			set_option(acceptor, fast_open(socket.fast_open_queue),
+				"TCP_FASTOPEN");
+		}
+#endif
+
+		acceptor.listen(options_.listen_backlog);
+
+		// Pending connections are accepted until the backlog is empty
+		acceptor.non_blocking(true);
+
+		return acceptor;
+	}
+
 	void server::run(std::size_t thread_pool_size){
+		auto const worker = [this](
+			asio::io_service& io_service,
+			std::string const& name,
+			std::vector< unsigned > const& cpus
+		){
+			configure_thread(name, cpus);
+			while(!logsys::exception_catching_log(
+				[](logsys::stdlogb& os){ os << "I/O-Service"; },
+				[this, &io_service]{ run_io_service(io_service); }));
+		};
+
 		// Create a pool of threads to run all of the io_services.
-		futures_.reserve(thread_pool_size);
+		futures_.reserve(thread_pool_size + 1);
 		for(std::size_t i = 0; i < thread_pool_size; ++i){
-			futures_.emplace_back(std::async(std::launch::async, [this]{
-				while(!logsys::exception_catching_log(
-					[](logsys::stdlogb& os){ os << "I/O-Service"; },
-					[this]{ io_service_.run(); }));
-			}));
+			auto& io_service = shards_[i % shards_.size()]->io_service;
+			auto name = options_.thread_name_prefix + "-io-"
+				+ std::to_string(i);
+			auto cpus = options_.io_thread_cpus.empty()
+				? std::vector< unsigned >()
+				: options_.io_thread_cpus[i % options_.io_thread_cpus.size()];
+			futures_.emplace_back(std::async(std::launch::async,
+				[worker, &io_service, name = std::move(name),
+					cpus = std::move(cpus)
+				]{ worker(io_service, name, cpus); }));
+		}
+
+		if(accept_shard_){
+			futures_.emplace_back(std::async(std::launch::async,
+				[this, worker]{
+					worker(accept_shard_->io_service,
+						options_.thread_name_prefix + "-accept",
+						options_.accept_thread_cpus);
+				}));
+		}
+	}
+
+	void server::run_io_service(asio::io_service& io_service){
+		if(options_.busy_poll.count() == 0){
+			io_service.run();
+			return;
+		}
+
+		// The io_service stops as soon as it runs out of work
+		while(!io_service.stopped()){
+			auto const spin_end =
+				std::chrono::steady_clock::now() + options_.busy_poll;
+			while(io_service.poll() == 0 && !io_service.stopped()
+				&& std::chrono::steady_clock::now() < spin_end);
+
+			// Nothing happened within the spin budget, sleep in the kernel
+			if(std::chrono::steady_clock::now() >= spin_end){
+				io_service.run_one();
+			}
+		}
+	}
+
+	server::shard& server::connection_shard(
+		shard& listener,
+		listen_socket& acceptor
+	){
+		if(&listener != accept_shard_.get() && !acceptor.distribute){
+			return listener;
 		}
+
+		return *shards_[next_shard_++ % shards_.size()];
 	}
 
-	void server::start_accept(){
-		std::lock_guard< std::mutex > lock(acceptor_mutex_);
+	void server::start_accept(
+		shard& shard,
+		listen_socket& acceptor,
+		connection_ptr new_connection
+	){
+		std::lock_guard< std::mutex > lock(shard.acceptor_mutex);
 
-		if(!acceptor_.is_open()) return;
+		if(!acceptor.is_open()) return;
 
-		auto new_connection = make_shared_connection(io_service_);
+		if(!new_connection){
+			new_connection = connection_shard(shard, acceptor).pool->get();
+		}
 
-		acceptor_.async_accept(
+		acceptor.async_accept(
 			new_connection->socket(),
-			[this, new_connection](error_code const& err){
-				handle_accept(new_connection, err);
+			[this, &shard, &acceptor, new_connection](error_code const& err){
+				handle_accept(shard, acceptor, new_connection, err);
 			}
 		);
 	}
 
-	void server::stop_accept(){
-		std::lock_guard< std::mutex > lock(acceptor_mutex_);
+	void server::stop_accept(shard& shard){
+		std::lock_guard< std::mutex > lock(shard.acceptor_mutex);
 
-		acceptor_.close();
+		for(auto& acceptor: shard.acceptors){
+			error_code ignored_error;
+			acceptor.close(ignored_error);
+		}
 	}
 
 	void server::handle_accept(
+		shard& shard,
+		listen_socket& acceptor,
 		connection_ptr const& new_connection,
 		error_code const& err
 	){
 		if(!err){
+			admit(acceptor, new_connection);
+		}
+
+		bool const pause = options_.overload == overload_policy::pause_accept;
+
+		// Drain the backlog before waiting again
+		connection_ptr next_connection;
+		{
+			std::lock_guard< std::mutex > lock(shard.acceptor_mutex);
+
+			for(std::size_t i = 1;
+				i < options_.max_accepts_per_wakeup && acceptor.is_open()
+					&& !(pause && connection_manager_.connections_exhausted());
+				++i
+			){
+				next_connection = connection_shard(shard, acceptor).pool->get();
+
+				error_code accept_error;
+				acceptor.accept(next_connection->socket(), accept_error);
+				if(accept_error) break;
+
+				admit(acceptor, next_connection);
+				next_connection.reset();
+			}
+		}
+
+		// Leave further connections in the backlog until one is closed
+		if(pause && connection_manager_.connections_exhausted()){
+			{
+				std::lock_guard< std::mutex > lock(paused_mutex_);
+				if(stopped_) return;
+				paused_acceptors_.push_back(paused_acceptor{
+					shard, acceptor, std::move(next_connection)});
+			}
+
+			connection_manager_.pause();
+			return;
+		}
+
+		start_accept(shard, acceptor, std::move(next_connection));
+	}
+
+	void server::admit(
+		listen_socket const& acceptor,
+		connection_ptr const& new_connection
+	){
+		if(connection_manager_.add_connection()){
+			configure_socket(acceptor, new_connection->socket());
 			new_connection->start(request_handler_);
+		}else{
+			reject(new_connection);
+		}
+	}
+
+	void server::configure_socket(
+		listen_socket const& acceptor,
+		stream_protocol::socket& socket
+	){
+		if(!acceptor.tcp) return;
+
+		set_common_options(socket, options_.socket);
+
+#ifdef TCP_QUICKACK
+		if(options_.socket.quick_ack){
+			set_option(socket, quick_ack(true), "TCP_QUICKACK");
+		}
+#endif
+
+#ifdef SO_BUSY_POLL
+		if(options_.socket_busy_poll.count() != 0){
+			set_option(socket, busy_poll(static_cast< int >(
+				options_.socket_busy_poll.count())), "SO_BUSY_POLL");
 		}
+#endif
+	}
+
+	void server::reject(connection_ptr const& new_connection){
+		// A fresh socket buffer takes the small reply at once, if not the
+		// client gets a reset
+		auto& socket = new_connection->socket();
+		auto const& reply = connection_manager_.overload_reply();
 
-		start_accept();
+		error_code ignored_error;
+		socket.non_blocking(true, ignored_error);
+		socket.write_some(asio::buffer(reply), ignored_error);
+		socket.shutdown(stream_protocol::socket::shutdown_both, ignored_error);
+		socket.close(ignored_error);
 	}
 
+	void server::resume_accept(){
+		std::vector< paused_acceptor > paused;
+		{
+			std::lock_guard< std::mutex > lock(paused_mutex_);
+			paused.swap(paused_acceptors_);
+		}
+
+		// Called by the closing connection, accept outside of its context
+		for(auto& entry: paused){
+			entry.shard.io_service.post(
+				[this, &shard = entry.shard, &acceptor = entry.acceptor,
+					next_connection = std::move(entry.next_connection)
+				]()mutable{
+					start_accept(shard, acceptor, std::move(next_connection));
+				});
+		}
+	}
 
 }
@@ -0,0 +1,80 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#ifndef _http__server_socket_option__hpp_INCLUDED_
+#define _http__server_socket_option__hpp_INCLUDED_
+
+#include <boost/asio.hpp>
+
+
+// Socket options asio doesn't provide, used by the implementation only
+namespace http::server{
+
+
+	namespace asio = boost::asio;
+
+
+#ifdef SO_REUSEPORT
+	/// \brief Socket option SO_REUSEPORT
+	using reuse_port =
+		asio::detail::socket_option::boolean< SOL_SOCKET, SO_REUSEPORT >;
+#endif
+
+#ifdef SO_BUSY_POLL
+	/// \brief Socket option SO_BUSY_POLL
+	using busy_poll =
+		asio::detail::socket_option::integer< SOL_SOCKET, SO_BUSY_POLL >;
+#endif
+
+#ifdef TCP_DEFER_ACCEPT
+	/// \brief Socket option TCP_DEFER_ACCEPT
+	using defer_accept = asio::detail::socket_option::integer<
+		IPPROTO_TCP, TCP_DEFER_ACCEPT >;
+#endif
+
+#ifdef TCP_FASTOPEN
+	/// \brief Socket option TCP_FASTOPEN
+	using fast_open =
+		asio::detail::socket_option::integer< IPPROTO_TCP, TCP_FASTOPEN >;
+#endif
+
+#ifdef TCP_QUICKACK
+	/// \brief Socket option TCP_QUICKACK
+	using quick_ack =
+		asio::detail::socket_option::boolean< IPPROTO_TCP, TCP_QUICKACK >;
+#endif
+
+#ifdef TCP_KEEPIDLE
+	/// \brief Socket option TCP_KEEPIDLE
+	using keep_alive_idle =
+		asio::detail::socket_option::integer< IPPROTO_TCP, TCP_KEEPIDLE >;
+#endif
+
+#ifdef TCP_KEEPINTVL
+	/// \brief Socket option TCP_KEEPINTVL
+	using keep_alive_interval = asio::detail::socket_option::integer<
+		IPPROTO_TCP, TCP_KEEPINTVL >;
+#endif
+
+#ifdef TCP_KEEPCNT
+	/// \brief Socket option TCP_KEEPCNT
+	using keep_alive_count =
+		asio::detail::socket_option::integer< IPPROTO_TCP, TCP_KEEPCNT >;
+#endif
+
+#ifdef TCP_CORK
+	/// \brief Socket option TCP_CORK
+	using tcp_cork =
+		asio::detail::socket_option::boolean< IPPROTO_TCP, TCP_CORK >;
+#endif
+
+
+}
+
+
+#endif
@@ -0,0 +1,208 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012-2018 Benjamin Buch
+//
+// https://github.com/bebuch/http
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+//-----------------------------------------------------------------------------
+#include <http/server_timer_wheel.hpp>
+
+
+namespace http::server{
+
+
+	using boost::system::error_code;
+
+
+	timer_wheel::entry::~entry(){
+		if(wheel_) wheel_->cancel(*this);
+	}
+
+	void timer_wheel::entry::callback(std::function< void() > callback){
+		callback_ = std::move(callback);
+	}
+
+
+	timer_wheel::timer_wheel(
+		asio::io_service& io_service,
+		clock::duration resolution
+	):
+		timer_(io_service),
+		resolution_(resolution),
+		epoch_(clock::now())
+		{}
+
+	timer_wheel::~timer_wheel(){
+		std::lock_guard< std::mutex > lock(mutex_);
+
+		error_code ignored_error;
+		timer_.cancel(ignored_error);
+
+		// Detach all remaining entries
+		for(auto& level: slots_){
+			for(auto& slot: level){
+				while(slot){
+					entry& first = *slot;
+					unlink(first);
+				}
+			}
+		}
+	}
+
+	void timer_wheel::schedule(entry& entry, clock::duration timeout){
+		auto const now = clock::now();
+
+		std::lock_guard< std::mutex > lock(mutex_);
+
+		if(entry.wheel_) unlink(entry);
+
+		// An empty wheel does not tick, it jumps to the current time
+		if(count_ == 0) current_tick_ = tick(now);
+
+		// Round up, an entry never expires too early
+		entry.expiry_ = tick(now + timeout + resolution_ - clock::duration(1));
+		insert(entry);
+
+		if(!armed_) arm();
+	}
+
+	void timer_wheel::cancel(entry& entry){
+		std::lock_guard< std::mutex > lock(mutex_);
+
+		if(entry.wheel_) unlink(entry);
+	}
+
+	std::uint64_t timer_wheel::tick(clock::time_point time)const{
+		return static_cast< std::uint64_t >((time - epoch_) / resolution_);
+	}
+
+	void timer_wheel::insert(entry& entry){
+		// Expired entries are processed by the next tick
+		if(entry.expiry_ <= current_tick_) entry.expiry_ = current_tick_ + 1;
+
+		std::uint64_t const delta = entry.expiry_ - current_tick_;
+
+		// Find the lowest level, whose range covers the expiry
+		std::size_t level = 0;
+		while(level + 1 < level_count
+			&& delta >= (std::uint64_t(1) << (slot_bits * (level + 1)))
+		) ++level;
+
+		// Beyond the range of the highest level an entry is cascaded again
+		// when it comes in range
+		std::uint64_t const max_delta =
+			(std::uint64_t(1) << (slot_bits * level_count)) - 1;
+		std::uint64_t const position = delta > max_delta
+			? current_tick_ + max_delta : entry.expiry_;
+
+		auto& slot = slots_[level]
+			[(position >> (slot_bits * level)) & (slot_count - 1)];
+
+		entry.wheel_ = this;
+		entry.slot_ = &slot;
+		entry.prev_ = nullptr;
+		entry.next_ = slot;
+		if(slot) slot->prev_ = &entry;
+		slot = &entry;
+
+		++count_;
+	}
+
+	void timer_wheel::unlink(entry& entry){
+		if(entry.prev_){
+			entry.prev_->next_ = entry.next_;
+		}else{
+			*entry.slot_ = entry.next_;
+		}
+
+		if(entry.next_) entry.next_->prev_ = entry.prev_;
+
+		entry.wheel_ = nullptr;
+		entry.slot_ = nullptr;
+		entry.prev_ = nullptr;
+		entry.next_ = nullptr;
+
+		--count_;
+	}
+
+	void timer_wheel::cascade(std::size_t level){
+		std::size_t const index =
+			(current_tick_ >> (slot_bits * level)) & (slot_count - 1);
+
+		entry* list = slots_[level][index];
+		slots_[level][index] = nullptr;
+
+		while(list){
+			entry& entry = *list;
+			list = entry.next_;
+
+			entry.prev_ = nullptr;
+			entry.next_ = nullptr;
+			--count_;
+			insert(entry);
+		}
+	}
+
+	void timer_wheel::arm(){
+		armed_ = true;
+		timer_.expires_at(epoch_ + resolution_ * (current_tick_ + 1));
+		timer_.async_wait([this](error_code const& err){
+			handle_tick(err);
+		});
+	}
+
+	void timer_wheel::handle_tick(error_code const& err){
+		if(err == asio::error::operation_aborted) return;
+
+		// The member keeps its capacity for the next tick
+		std::vector< std::function< void() > > expired;
+
+		{
+			std::lock_guard< std::mutex > lock(mutex_);
+
+			expired.swap(expired_);
+
+			armed_ = false;
+
+			std::uint64_t const now_tick = tick(clock::now());
+			while(current_tick_ < now_tick && count_ > 0){
+				++current_tick_;
+
+				// A wrap of a level moves the entries of the next slot of
+				// the level above down
+				for(std::size_t level = 1; level < level_count; ++level){
+					if(((current_tick_ >> (slot_bits * (level - 1)))
+						& (slot_count - 1)) != 0) break;
+					cascade(level);
+				}
+
+				auto& slot = slots_[0][current_tick_ & (slot_count - 1)];
+				while(slot){
+					entry& entry = *slot;
+					unlink(entry);
+					if(entry.callback_){
+						expired.push_back(entry.callback_);
+					}
+				}
+			}
+
+			if(count_ > 0){
+				arm();
+			}else{
+				current_tick_ = now_tick;
+			}
+		}
+
+		// The callbacks may schedule entries again
+		for(auto& callback: expired){
+			callback();
+		}
+		expired.clear();
+
+		std::lock_guard< std::mutex > lock(mutex_);
+		if(expired_.capacity() < expired.capacity()) expired_.swap(expired);
+	}
+
+
+}
@@ -177,12 +177,12 @@ namespace http::websocket::server{
 
 		if(new_connection_callback_) new_connection_callback_(connection);
 
-		receive(connection, "");
+		receive(connection, std::string_view());
 	}
 
 	void service::receive(
 		http::server::connection_ptr const& connection,
-		std::string const& data
+		std::string_view data
 	){
 		boost::tribool result;
 		auto info = [this, &connection]{
@@ -201,7 +201,7 @@ namespace http::websocket::server{
 		auto& parser = info->parser;
 		auto& continuation_frames = info->continuation_frames;
 
-		std::string::const_iterator iter = data.begin();
+		std::string_view::const_iterator iter = data.begin();
 		do{
 			websocket::frame frame;
 			std::tie(result, iter) = parser.parse(frame, iter, data.end());
@@ -216,13 +216,14 @@ namespace http::websocket::server{
 
 		if(!result){
 			// There was an error while parsing
-			close(1002, "Read-Error: Parsing-Error in '" + data + "'",
-				connection);
+			close(1002, "Read-Error: Parsing-Error in '" + std::string(data)
+				+ "'", connection);
 		}else{
-			// wait for more messages
-			connection->read([this](
-				http::server::connection_ptr connection,
-				std::string const& data,
+			// wait for more messages, the parser keeps the state of an
+			// incomplete frame, so all data is consumed
+			connection->read_view([this](
+				http::server::connection_ptr const& connection,
+				std::string_view data,
 				error_code const& err
 			){
 				if(!err){
@@ -230,6 +231,7 @@ namespace http::websocket::server{
 				}else{
 					close(1002, "Read-Error: " + err.message(), connection);
 				}
+				return data.size();
 			});
 		}
 	}
@@ -373,12 +375,18 @@ namespace http::websocket::server{
 		std::shared_ptr< std::string const > const& data,
 		http::server::connection_ptr const& connection
 	){
-		if(auto err = connection->write(data)){
+		// A slow client is removed, when its write queue is full
+		connection->write(data, [this](
+			http::server::connection_ptr const& connection,
+			error_code const& err
+		){
+			if(!err) return;
+
 			logsys::log([&err](logsys::stdlogb& os){
 				os << "Error: WebSocket service write: " << err.message();
 			});
 			remove_connection(connection);
-		}
+		});
 	}
 
 	void service::send_close_frame_data(
@@ -400,10 +408,13 @@ namespace http::websocket::server{
 	void service::remove_connection(
 		http::server::connection_ptr const& connection
 	){
-		if(connection_close_callback_) connection_close_callback_(connection);
+		// A failed write may remove the connection a second time
+		{
+			std::lock_guard< std::mutex > lock(mutex_);
+			if(connections_.erase(connection) == 0) return;
+		}
 
-		std::lock_guard< std::mutex > lock(mutex_);
-		connections_.erase(connection);
+		if(connection_close_callback_) connection_close_callback_(connection);
 	}
 
 	std::vector< http::server::connection_ptr > service::get_connections(){